@@ -14,6 +14,13 @@
 #include <iostream>
 #include <vector>
 #include <stdexcept>
+#include <sstream>
+#include <memory>
+#include <cstring>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /**
  * @brief uses basic vector to create "byte-vector"
@@ -143,45 +150,499 @@ class LexToken
 {
 private:
     bytes data;
+    //decoded STRING/CHAR literal, points into arena chunk and keeps the chunk alive
+    std::shared_ptr<const unsigned char> literal;
+    size_t literalSize = 0;
     Tokens type;
     long lineNum;
     long lineCol;
 public:
     LexToken(bytes _data, Tokens _type, long _lineNum, long _lineCol);
-    ~LexToken();
-    inline bytes getData() {return data;}
+
+    /**
+     * @brief Construct a new Lex Token object for decoded literal (no copy is made)
+     * 
+     * @param _literal decoded bytes, shares ownership of arena chunk (token may outlive LexAutomata)
+     * @param _size number of bytes
+     */
+    LexToken(std::shared_ptr<const unsigned char> _literal, size_t _size, Tokens _type, long _lineNum, long _lineCol);
+    inline bytes getData() {return literal != nullptr ? bytes(literal.get(), literal.get() + literalSize) : data;}
+    inline const unsigned char* getLiteral() {return literal.get();}
+    inline size_t getLiteralSize() {return literalSize;}
     inline Tokens getType() {return type;}
+    //position of first byte of token (opening quote for literals)
     inline long getLn() {return lineNum;}
     inline long getCol() {return lineCol;}
 };
 
 LexToken::LexToken(bytes _data, Tokens _type, long _lineNum, long _lineCol)
 {
-    data =_data;
+    data = std::move(_data);
     type = _type;
     lineNum = _lineNum;
     lineCol = _lineCol;
 }
 
-LexToken::~LexToken()
+LexToken::LexToken(std::shared_ptr<const unsigned char> _literal, size_t _size, Tokens _type, long _lineNum, long _lineCol)
 {
+    literal = std::move(_literal);
+    literalSize = _size;
+    type = _type;
+    lineNum = _lineNum;
+    lineCol = _lineCol;
 }
 
+/**
+ * @brief size of input block read at once
+ * 
+ */
+#define LEX_INPUT_BLOCK 65536
 
-class LexAutomata
+/**
+ * @brief size of one literal arena chunk
+ * 
+ */
+#define LEX_ARENA_CHUNK 65536
+
+/**
+ * @brief append-only storage for decoded literals.
+ * Chunks are never moved and are shared with tokens, so a chunk lives
+ * while arena writes to it or any token points into it.
+ * 
+ */
+class LexLiteralArena
+{
+private:
+    std::shared_ptr<unsigned char[]> chunk;
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t start = 0;
+
+    /**
+     * @brief moves current (unfinished) literal to a new chunk with space for _need more bytes
+     * 
+     */
+    void grow(size_t _need)
+    {
+        size_t len = used - start;
+        size_t newCapacity = 2 * (len + _need) > LEX_ARENA_CHUNK ? 2 * (len + _need) : LEX_ARENA_CHUNK;
+        std::shared_ptr<unsigned char[]> newChunk(new unsigned char[newCapacity]);
+        if(len != 0) memcpy(newChunk.get(), chunk.get() + start, len);
+        chunk = std::move(newChunk);
+        capacity = newCapacity;
+        start = 0;
+        used = len;
+    }
+public:
+    /**
+     * @brief starts new literal
+     * 
+     */
+    inline void begin() {start = used;}
+
+    inline void append(const unsigned char* _data, size_t _size)
+    {
+        if(_size == 0) return;
+        if(used + _size > capacity) grow(_size);
+        memcpy(chunk.get() + used, _data, _size);
+        used += _size;
+    }
+
+    inline void push(unsigned char _c)
+    {
+        if(used == capacity) grow(1);
+        chunk[used++] = _c;
+    }
+
+    /**
+     * @brief drops current literal, its space is reused
+     * 
+     */
+    inline void discard() {used = start;}
+
+    /**
+     * @brief current literal
+     * 
+     */
+    inline const unsigned char* data() {return chunk.get() + start;}
+
+    /**
+     * @brief current literal sharing ownership of its chunk
+     * 
+     */
+    inline std::shared_ptr<const unsigned char> share() {return std::shared_ptr<const unsigned char>(chunk, chunk.get() + start);}
+    inline size_t size() {return used - start;}
+};
+
+
+/**
+ * @brief length of UTF-8 sequence by its lead byte
+ * 
+ * @return 1-4, 0 for continuation byte or invalid lead
+ */
+constexpr int lexUtf8Length(unsigned char _lead)
+{
+    if(_lead < 0x80) return 1;
+    if(_lead >= 0xC2 && _lead <= 0xDF) return 2;
+    if(_lead >= 0xE0 && _lead <= 0xEF) return 3;
+    if(_lead >= 0xF0 && _lead <= 0xF4) return 4;
+    return 0;
+}
+
+/**
+ * @brief errors of STRING and CHAR literals, same for LexAutomata and lexConstexprScan
+ * 
+ */
+enum LexLiteralError {
+    LITERAL_OK,
+    LITERAL_UNTERMINATED_STRING,
+    LITERAL_UNTERMINATED_CHAR,
+    LITERAL_EMPTY_CHAR,
+    LITERAL_CHAR_NOT_ONE_SYMBOL,
+    LITERAL_INVALID_UTF8_CHAR,
+    LITERAL_UNKNOWN_ESCAPE,
+    LITERAL_BAD_HEX_ESCAPE,
+    LITERAL_NO_UNICODE_BRACE,
+    LITERAL_BAD_UNICODE_DIGIT,
+    LITERAL_UNICODE_TOO_LONG,
+    LITERAL_EMPTY_UNICODE,
+    LITERAL_UNICODE_OUT_OF_RANGE,
+    LITERAL_UNICODE_SURROGATE,
+    LITERAL_UNTERMINATED_ESCAPE,
+};
+
+const char* const stringLiteralErrors[15] = {
+    "OK",
+    "Unterminated string literal",
+    "Unterminated char literal",
+    "Empty char literal",
+    "Char must be only one symbol",
+    "Invalid UTF-8 in char literal",
+    "Unknown escape sequence",
+    "Expected two hex digits in '\\x' escape",
+    "Expected '{' after '\\u'",
+    "Expected hex digit or '}' in '\\u{...}' escape",
+    "Too many hex digits in '\\u{...}' escape (max 6)",
+    "Empty '\\u{}' escape",
+    "Code point in '\\u{...}' escape is out of range (max 10FFFF)",
+    "Code point in '\\u{...}' escape is a surrogate",
+    "Unterminated escape sequence",
+};
+
+/**
+ * @brief checks for [0-9a-fA-F]
+ * 
+ * @param _c byte or -1
+ */
+constexpr bool lexIsHex(int _c) {return (_c >= '0' && _c <= '9') || (_c >= 'a' && _c <= 'f') || (_c >= 'A' && _c <= 'F');}
+
+constexpr unsigned lexHexValue(int _c) {return _c <= '9' ? _c - '0' : (_c | 0x20) - 'a' + 10;}
+
+/**
+ * @brief keywords and types of Theia, anything else of letters and digits is ID
+ * 
+ */
+struct LexKeyword
+{
+    const char* text;
+    size_t size;
+    Tokens type;
+};
+
+//sorted by size
+constexpr LexKeyword lexKeywords[] = {
+    {"if", 2, Tokens::KW_IF},
+    {"int", 3, Tokens::TYPE_INT}, {"for", 3, Tokens::KW_FOR},
+    {"bool", 4, Tokens::TYPE_BOOL}, {"byte", 4, Tokens::TYPE_BYTE}, {"long", 4, Tokens::TYPE_LONG},
+    {"char", 4, Tokens::TYPE_CHAR}, {"void", 4, Tokens::TYPE_VOID}, {"else", 4, Tokens::KW_ELSE},
+    {"enum", 4, Tokens::KW_ENUM}, {"case", 4, Tokens::KW_CASE},
+    {"short", 5, Tokens::TYPE_SHORT}, {"class", 5, Tokens::KW_CLASS}, {"const", 5, Tokens::KW_CONST},
+    {"break", 5, Tokens::KW_BREAK}, {"while", 5, Tokens::KW_WHILE},
+    {"uint32", 6, Tokens::TYPE_UINT32}, {"uint64", 6, Tokens::TYPE_UINT64}, {"double", 6, Tokens::TYPE_DOUBLE},
+    {"string", 6, Tokens::TYPE_STRING}, {"public", 6, Tokens::KW_PUBLIC}, {"return", 6, Tokens::KW_RETURN},
+    {"switch", 6, Tokens::KW_SWITCH},
+    {"uint128", 7, Tokens::TYPE_UINT128}, {"uint256", 7, Tokens::TYPE_UINT256}, {"extends", 7, Tokens::KW_EXTENDS},
+    {"private", 7, Tokens::KW_PRIVATE}, {"default", 7, Tokens::KW_DEFAULT},
+    {"waddress", 8, Tokens::TYPE_WADDRESS}, {"continue", 8, Tokens::KW_CONTINUE},
+};
+
+/**
+ * @brief size of the longest keyword
+ * 
+ */
+#define LEX_KEYWORD_MAX 8
+
+/**
+ * @brief first[n] is index of the first keyword of n bytes in lexKeywords
+ * 
+ */
+struct LexKeywordIndex
+{
+    size_t first[LEX_KEYWORD_MAX + 2];
+};
+
+constexpr LexKeywordIndex lexKeywordIndex = [] {
+    LexKeywordIndex index = {};
+    size_t k = 0;
+    for (size_t n = 0; n < LEX_KEYWORD_MAX + 2; n++)
+    {
+        while(k < sizeof(lexKeywords) / sizeof(lexKeywords[0]) && lexKeywords[k].size < n) k++;
+        index.first[n] = k;
+    }
+    return index;
+}();
+
+/**
+ * @brief keyword or ID
+ * 
+ * @param _s word
+ * @param _size number of bytes
+ */
+template<typename Char>
+constexpr Tokens lexKeyword(const Char* _s, size_t _size)
+{
+    if(_size > LEX_KEYWORD_MAX) return Tokens::ID;
+    for (size_t k = lexKeywordIndex.first[_size]; k < lexKeywordIndex.first[_size + 1]; k++)
+    {
+        size_t i = 0;
+        while(i < _size && lexKeywords[k].text[i] == (char)_s[i]) i++;
+        if(i == _size) return lexKeywords[k].type;
+    }
+    return Tokens::ID;
+}
+
+/**
+ * @brief encodes code point as UTF-8
+ * 
+ * @param _cp code point, valid and not a surrogate
+ * @param _push receives bytes
+ */
+template<typename Push>
+constexpr void lexEncodeUtf8(unsigned long _cp, Push&& _push)
+{
+    if(_cp < 0x80) _push(_cp);
+    else if(_cp < 0x800)
+    {
+        _push(0xC0 | (_cp >> 6));
+        _push(0x80 | (_cp & 0x3F));
+    }
+    else if(_cp < 0x10000)
+    {
+        _push(0xE0 | (_cp >> 12));
+        _push(0x80 | ((_cp >> 6) & 0x3F));
+        _push(0x80 | (_cp & 0x3F));
+    }
+    else
+    {
+        _push(0xF0 | (_cp >> 18));
+        _push(0x80 | ((_cp >> 12) & 0x3F));
+        _push(0x80 | ((_cp >> 6) & 0x3F));
+        _push(0x80 | (_cp & 0x3F));
+    }
+}
+
+/**
+ * @brief decodes escape sequence after '\\'
+ * 
+ * @param _next consumes and returns next byte of source, -1 at end
+ * @param _push receives decoded bytes
+ * @return LITERAL_OK or error, last byte returned by _next is the offending one
+ */
+template<typename Next, typename Push>
+constexpr LexLiteralError lexDecodeEscape(Next&& _next, Push&& _push)
+{
+    int c = _next();
+    switch (c)
+    {
+    case 'n': _push('\n'); return LITERAL_OK;
+    case 't': _push('\t'); return LITERAL_OK;
+    case '\\': _push('\\'); return LITERAL_OK;
+    case '"': _push('"'); return LITERAL_OK;
+    case '\'': _push('\''); return LITERAL_OK;
+    case 'x':
+    {
+        unsigned value = 0;
+        for (int i = 0; i < 2; i++)
+        {
+            c = _next();
+            if(!lexIsHex(c)) return LITERAL_BAD_HEX_ESCAPE;
+            value = (value << 4) | lexHexValue(c);
+        }
+        _push(value);
+        return LITERAL_OK;
+    }
+    case 'u':
+    {
+        if(_next() != '{') return LITERAL_NO_UNICODE_BRACE;
+        unsigned long value = 0;
+        int digits = 0;
+        while((c = _next()) != '}')
+        {
+            if(!lexIsHex(c)) return LITERAL_BAD_UNICODE_DIGIT;
+            if(++digits > 6) return LITERAL_UNICODE_TOO_LONG;
+            value = (value << 4) | lexHexValue(c);
+        }
+        if(digits == 0) return LITERAL_EMPTY_UNICODE;
+        if(value > 0x10FFFF) return LITERAL_UNICODE_OUT_OF_RANGE;
+        if(value >= 0xD800 && value <= 0xDFFF) return LITERAL_UNICODE_SURROGATE;
+        lexEncodeUtf8(value, _push);
+        return LITERAL_OK;
+    }
+    default:
+        return c == -1 ? LITERAL_UNTERMINATED_ESCAPE : LITERAL_UNKNOWN_ESCAPE;
+    }
+}
+
+/**
+ * @brief counts symbols of char literal on source side (used by LexAutomata and lexConstexprScan):
+ * escape sequence or one raw UTF-8 sequence is one symbol
+ * 
+ */
+struct LexCharSymbols
+{
+    long symbols = 0;
+    //continuation bytes still expected by current raw sequence
+    int pending = 0;
+    bool invalid = false;
+
+    constexpr void raw(unsigned char _c)
+    {
+        if(pending > 0)
+        {
+            if((_c & 0xC0) == 0x80) pending--;
+            else invalid = true;
+            return;
+        }
+        int length = lexUtf8Length(_c);
+        if(length == 0) invalid = true;
+        pending = length > 0 ? length - 1 : 0;
+        symbols++;
+    }
+
+    constexpr void escape()
+    {
+        if(pending > 0) invalid = true;
+        symbols++;
+    }
+
+    /**
+     * @brief checks closed char literal
+     * 
+     */
+    constexpr LexLiteralError check() const
+    {
+        if(invalid || pending != 0) return LITERAL_INVALID_UTF8_CHAR;
+        if(symbols == 0) return LITERAL_EMPTY_CHAR;
+        if(symbols != 1) return LITERAL_CHAR_NOT_ONE_SYMBOL;
+        return LITERAL_OK;
+    }
+};
+
+/**
+ * @brief number of bins of identifier length histogram (last bin is "this or longer")
+ * 
+ */
+#define LEX_STATS_ID_BINS 65
+
+/**
+ * @brief number of bins of literal size histogram (bin k holds sizes of k significant bits)
+ * 
+ */
+#define LEX_STATS_SIZE_BINS 65
+
+/**
+ * @brief counters of count-only mode (LexAutomata::scanStats), no tokens are kept
+ * 
+ */
+struct LexStats
+{
+    unsigned long long lines = 0;
+    unsigned long long bytes = 0;
+    unsigned long long tokens = 0;
+    unsigned long long byType[Tokens::MES_COLON + 1] = {};
+    unsigned long long idLengths[LEX_STATS_ID_BINS] = {};
+    unsigned long long literalSizes[LEX_STATS_SIZE_BINS] = {};
+    unsigned long long literalBytes = 0;
+    unsigned long long comments = 0;
+    unsigned long long commentBytes = 0;
+};
+
+/**
+ * @brief source of input blocks for LexAutomata
+ * 
+ */
+class LexSource
+{
+public:
+    virtual ~LexSource() {}
+
+    /**
+     * @brief gives next block of input. Previous block is released by this call
+     * 
+     * @param _data receives pointer to block, valid until next call
+     * @return block size, 0 on end of input
+     */
+    virtual size_t nextBlock(const unsigned char** _data) = 0;
+};
+
+/**
+ * @brief reads FILE* by blocks of LEX_INPUT_BLOCK
+ * 
+ */
+class LexFileSource : public LexSource
 {
 private:
     FILE* f;
+    bool ownsFile;
+    bytes block;
+public:
+    /**
+     * @brief Construct a new Lex File Source object
+     * 
+     * @param _f opened file
+     * @param _ownsFile close file in destructor
+     */
+    LexFileSource(FILE* _f, bool _ownsFile) : f(_f), ownsFile(_ownsFile), block(LEX_INPUT_BLOCK) {}
+    ~LexFileSource() {if(ownsFile) fclose(f);}
+
+    size_t nextBlock(const unsigned char** _data) override
+    {
+        *_data = block.data();
+        return fread(block.data(), 1, block.size(), f);
+    }
+};
+
+class LexAutomata
+{
+private:
+    LexSource* source;
+    std::unique_ptr<LexSource> ownedSource;
     bytes buffer = {};
     bytes lineBuffer = {};
     bool exponentNumber = false;
-    bool isChar = false;
-    bool isString = false;
+    //input is read by blocks, FSM walks the block with inPos
+    const unsigned char* input = nullptr;
+    size_t inPos = 0;
+    size_t inEnd = 0;
+    LexLiteralArena literals;
+    LexCharSymbols charSymbols;
     int currentByte;
     long lineNum;
     long lineCol;
+    //position of first byte of current token
+    long tokenLine = 1;
+    long tokenCol = 1;
     long fileLength;
-    std::string parsingState;
+    //state name for diagnostics, assigned on every state so kept as plain pointer
+    const char* parsingState;
+    std::string parsingDetail;
+    std::string lastError;
+    //bytes read from source
+    unsigned long long inTotal = 0;
+    //last byte of previous block, to count unterminated last line
+    int lastInputByte = '\n';
+    //lineBuffer is maintained per byte only for diagnostics of token scans
+    bool keepLine = true;
 public:
     /**
      * @brief Construct a new Lex Automata object
@@ -196,10 +657,46 @@ public:
      * @param _path path to file
      */
     LexAutomata(std::string _path);
+
+    /**
+     * @brief Construct a new Lex Automata object
+     * 
+     * @param _source block source, must outlive lexer
+     */
+    LexAutomata(LexSource* _source);
     ~LexAutomata();
 
+    /**
+     * @brief scans whole input into _dest and prints tokens (or error) to stdout
+     *
+     * @param _dest output vector
+     */
     void scanTokens(std::vector<LexToken>* _dest);
 
+    /**
+     * @brief runs FSM over whole input without printing anything.
+     * Sink must provide push_back(LexToken&&) (std::vector<LexToken> works)
+     *
+     * @param _dest token sink
+     * @return true if input was lexed to the end, false on lexing or read error (see getLastError())
+     */
+    template<typename Sink>
+    bool scanInto(Sink* _dest);
+
+    /**
+     * @brief count-only mode: runs FSM without creating tokens and fills _stats
+     * 
+     * @param _stats counters, added to (not reset)
+     * @return true if input was lexed to the end, false on lexing or read error (see getLastError())
+     */
+    bool scanStats(LexStats* _stats);
+
+    /**
+     * @brief Get diagnostic of the last failed scan
+     *
+     */
+    inline const std::string& getLastError() {return lastError;}
+
 private:
     /**
      * @brief checks for [a-zA-Z]
@@ -244,19 +741,26 @@ private:
     inline bool isBrackets(unsigned char _c) {return _c == '{' || _c == '}' || _c == '(' || _c == ')' || _c == '[' || _c == ']';}
 
     /**
-     * @brief compare bytes with string
+     * @brief reads next block of input
      * 
-     * @param _source 
-     * @param _with 
+     * @return false on end of file
      */
-    bool compare(bytes _source, std::string _with)
-    {
-        if(_source.size() != _with.size()) return false;
-        for (size_t i = 0; i < _source.size(); i++)
+    inline bool refill() {
+        if(inEnd != 0)
         {
-            if(_source[i] != _with[i]) return false;
+            lastInputByte = input[inEnd - 1];
+            //without per-byte tracking keep tail of current line, block is gone after nextBlock
+            if(!keepLine)
+            {
+                size_t keep = (size_t)lineCol < inEnd ? lineCol : inEnd;
+                if((size_t)lineCol <= inEnd) lineBuffer.clear();
+                lineBuffer.insert(lineBuffer.end(), input + inEnd - keep, input + inEnd);
+            }
         }
-        return true;
+        inPos = 0;
+        inEnd = source->nextBlock(&input);
+        inTotal += inEnd;
+        return inEnd != 0;
     }
 
     /**
@@ -264,36 +768,149 @@ private:
      * 
      */
     inline void getNextByte() {
-        currentByte = getc(f);
+        if(inPos == inEnd && !refill()) currentByte = EOF;
+        else currentByte = input[inPos++];
         lineCol++;
-        lineBuffer.push_back(currentByte);
+        if(keepLine) lineBuffer.push_back(currentByte);
     };
 
     /**
      * @brief Return back current byte
+     * (only the byte just read, so it is always in current block)
      * 
      */
     inline void ungetByte() {
-        currentByte = ungetc(currentByte, f);
+        if(currentByte != EOF) inPos--;
         lineCol--;
-        lineBuffer.pop_back();
+        if(keepLine) lineBuffer.pop_back();
     };
 
+    /**
+     * @brief copies bytes of literal body up to next quote, backslash or new line
+     * (or end of current block) into literal arena. Stop byte is not consumed.
+     * 
+     * @param _quote closing quote
+     */
+    inline void scanLiteralRun(unsigned char _quote) {
+        size_t i = inPos;
+#if defined(__SSE2__)
+        const __m128i q = _mm_set1_epi8((char)_quote);
+        const __m128i bs = _mm_set1_epi8('\\');
+        const __m128i nl = _mm_set1_epi8('\n');
+        while(i + 16 <= inEnd)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(input + i));
+            __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs)), _mm_cmpeq_epi8(v, nl));
+            int mask = _mm_movemask_epi8(m);
+            if(mask != 0)
+            {
+                i += __builtin_ctz(mask);
+                goto FOUND;
+            }
+            i += 16;
+        }
+#endif
+        while(i < inEnd && input[i] != _quote && input[i] != '\\' && input[i] != '\n') i++;
+#if defined(__SSE2__)
+        FOUND:
+#endif
+        size_t n = i - inPos;
+        if(_quote == '\'')
+        {
+            for (size_t k = inPos; k < i; k++) charSymbols.raw(input[k]);
+        }
+        literals.append(input + inPos, n);
+        if(keepLine) lineBuffer.insert(lineBuffer.end(), input + inPos, input + i);
+        lineCol += n;
+        inPos = i;
+    }
+
+    /**
+     * @brief hands token from buffer to sink
+     * 
+     */
+    template<typename Sink>
+    inline void emitToken(Sink* _dest, Tokens _type, long _lineNum, long _lineCol) {
+        _dest->push_back(LexToken(buffer, _type, _lineNum, _lineCol));
+    }
+
+    inline void emitToken(LexStats* _dest, Tokens _type, long, long) {
+        _dest->tokens++;
+        _dest->byType[_type]++;
+        if(_type == Tokens::ID) _dest->idLengths[buffer.size() < LEX_STATS_ID_BINS ? buffer.size() : LEX_STATS_ID_BINS - 1]++;
+    }
+
+    /**
+     * @brief hands decoded literal from arena to sink
+     * 
+     */
+    template<typename Sink>
+    inline void emitLiteral(Sink* _dest, Tokens _type, long _lineNum, long _lineCol) {
+        _dest->push_back(LexToken(literals.share(), literals.size(), _type, _lineNum, _lineCol));
+    }
+
+    inline void emitLiteral(LexStats* _dest, Tokens _type, long, long) {
+        size_t size = literals.size();
+        _dest->tokens++;
+        _dest->byType[_type]++;
+        _dest->literalSizes[size == 0 ? 0 : 64 - __builtin_clzll(size)]++;
+        _dest->literalBytes += size;
+        //nobody references the literal, keep arena from growing
+        literals.discard();
+    }
+
+    /**
+     * @brief reports comment of _size bytes (with delimiters) to sink
+     * 
+     */
+    template<typename Sink>
+    inline void emitComment(Sink*, long) {}
+
+    inline void emitComment(LexStats* _dest, long _size) {
+        _dest->comments++;
+        _dest->commentBytes += _size;
+    }
+
+    /**
+     * @brief decodes escape sequence (current byte is '\\') into literal arena
+     * 
+     * @return false on malformed sequence, parsingState holds the reason
+     */
+    bool decodeEscape();
+
+    /**
+     * @brief the FSM itself, source errors are thrown out of it
+     * 
+     */
+    template<typename Sink>
+    bool scanFsm(Sink* _dest);
+
 };
 
 LexAutomata::LexAutomata(FILE* _f)
 {
     if(_f != nullptr)
     {
-        f = _f;
-        fseek(f, 0, SEEK_END);
-        fileLength = ftell(f);
-        rewind(f);
+        //stdin, pipes and FIFOs can not seek, they are read from current position
+        if(fseek(_f, 0, SEEK_END) == 0)
+        {
+            fileLength = ftell(_f);
+            rewind(_f);
+        }
+        else
+        {
+            clearerr(_f);
+            fileLength = -1;
+        }
+        //FILE* passed by user is closed by user
+        ownedSource.reset(new LexFileSource(_f, false));
+        source = ownedSource.get();
         buffer = {};
         lineBuffer = {};
         exponentNumber = false;
-        isChar = false;
-        isString = false;
+        input = nullptr;
+        inPos = 0;
+        inEnd = 0;
         currentByte = 0;
         lineNum = 1;
         lineCol = 0;
@@ -304,17 +921,20 @@ LexAutomata::LexAutomata(FILE* _f)
 
 LexAutomata::LexAutomata(std::string _path)
 {
-    f = fopen(_path.c_str(), "rb");
+    FILE* f = fopen(_path.c_str(), "rb");
     if(f != nullptr)
     {
         fseek(f, 0, SEEK_END);
         fileLength = ftell(f);
         rewind(f);
+        ownedSource.reset(new LexFileSource(f, true));
+        source = ownedSource.get();
         buffer = {};
         lineBuffer = {};
         exponentNumber = false;
-        isChar = false;
-        isString = false;
+        input = nullptr;
+        inPos = 0;
+        inEnd = 0;
         currentByte = 0;
         lineNum = 1;
         lineCol = 0;
@@ -323,21 +943,85 @@ LexAutomata::LexAutomata(std::string _path)
     else throw std::invalid_argument("argument '_path' is not invalid");
 }
 
+LexAutomata::LexAutomata(LexSource* _source)
+{
+    if(_source != nullptr)
+    {
+        source = _source;
+        fileLength = -1;
+        buffer = {};
+        lineBuffer = {};
+        exponentNumber = false;
+        input = nullptr;
+        inPos = 0;
+        inEnd = 0;
+        currentByte = 0;
+        lineNum = 1;
+        lineCol = 0;
+        parsingState = "";
+    }
+    else throw std::invalid_argument("argument '_source' is not invalid");
+}
+
 LexAutomata::~LexAutomata()
 {
-    delete f;
 }
 
-void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
+bool LexAutomata::decodeEscape()
+{
+    LexLiteralError error = lexDecodeEscape([&] {
+        getNextByte();
+        return currentByte;
+    }, [&](unsigned char _c) {literals.push(_c);});
+    if(error == LITERAL_OK) return true;
+    if(error == LITERAL_UNKNOWN_ESCAPE)
+    {
+        parsingDetail = std::string(stringLiteralErrors[error]) + " '\\" + (char)currentByte + "'";
+        parsingState = parsingDetail.c_str();
+    }
+    else parsingState = stringLiteralErrors[error];
+    return false;
+}
+
+template<typename Sink>
+bool LexAutomata::scanInto(Sink *_dest)
 {
     if(_dest == nullptr) throw std::invalid_argument("argument '_dest' is invalid");
+    try
+    {
+        return scanFsm(_dest);
+    }
+    catch(const std::runtime_error& e)
+    {
+        //read or decompression error of source
+        std::ostringstream err;
+        err << "Error at state: Reading input!\n";
+        err << "Error at: (Ln " << lineNum << ", Col " << lineCol << ")!\n";
+        err << e.what() << "\n\n";
+        lastError = err.str();
+        return false;
+    }
+}
+
+template<typename Sink>
+bool LexAutomata::scanFsm(Sink *_dest)
+{
     bool signedExponent = false;
+    unsigned char quote = 0;
+    long commentSize = 0;
+    lastError = "";
 
     goto START;
 
     SELECT_NEXT:
     {
         parsingState = "Selecting next routine";
+        //tokens are reported at their first byte, counters need no positions
+        if constexpr (!std::is_same_v<Sink, LexStats>)
+        {
+            tokenLine = lineNum;
+            tokenCol = lineCol;
+        }
         if(isAlpha(currentByte)) goto ALPHABET;
         if(isSpace(currentByte)) goto SPACE;
         if(isBrackets(currentByte)) goto BRACKETS;
@@ -363,8 +1047,8 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
         if(isNumber(currentByte)) goto NUMBER;
         if(currentByte == '.') goto NUMBERDOT;
         if(isAlpha(currentByte)) goto ERROR;
-        _dest->push_back(LexToken(buffer, Tokens::NUMBER, lineNum, lineCol));
-        buffer = {};
+        emitToken(_dest, Tokens::NUMBER, tokenLine, tokenCol);
+        buffer.clear();
         goto SELECT_NEXT;
     }
 
@@ -387,8 +1071,8 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
         if(isNumber(currentByte)) goto MANTISSA;
         if(currentByte == 'e' || currentByte == 'E') goto MNTSEXP;
         if(isAlpha(currentByte)) goto ERROR;
-        _dest->push_back(LexToken(buffer, Tokens::FLNUMBER, lineNum, lineCol));
-        buffer = {};
+        emitToken(_dest, Tokens::FLNUMBER, tokenLine, tokenCol);
+        buffer.clear();
         goto SELECT_NEXT;
     }
 
@@ -405,8 +1089,8 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
             {
                 if(signedExponent)
                 {
-                    _dest->push_back(LexToken(buffer, Tokens::FLNUMBER, lineNum, lineCol));
-                    buffer = {};
+                    emitToken(_dest, Tokens::FLNUMBER, tokenLine, tokenCol);
+                    buffer.clear();
                     exponentNumber = false;
                     signedExponent = false;
                     goto SELECT_NEXT;
@@ -420,8 +1104,8 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
             goto MNTSEXP;
         }
         if(isAlpha(currentByte)) goto ERROR;
-        _dest->push_back(LexToken(buffer, Tokens::FLNUMBER, lineNum, lineCol));
-        buffer = {};
+        emitToken(_dest, Tokens::FLNUMBER, tokenLine, tokenCol);
+        buffer.clear();
         exponentNumber = false;
         signedExponent = false;
         goto SELECT_NEXT;
@@ -433,7 +1117,7 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
         {
             lineNum++;
             lineCol = 0;
-            lineBuffer = {};
+            lineBuffer.clear();
         }
         getNextByte();
         goto SELECT_NEXT;
@@ -447,68 +1131,8 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
         if(isAlpha(currentByte) || isNumber(currentByte)) goto ALPHABET;
         else
         {
-            switch (buffer.size())
-            {
-            case 0:
-                goto ERROR;
-            case 1:
-                _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol - 1));
-                break;
-            case 2:
-                if(compare(buffer, "if")) _dest->push_back(LexToken(buffer, Tokens::KW_IF, lineNum, lineCol - 1));
-                else _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol - 1));
-                break;
-            case 3:
-                if(compare(buffer, "int")) _dest->push_back(LexToken(buffer, Tokens::TYPE_INT, lineNum, lineCol - 1));
-                else if(compare(buffer, "for")) _dest->push_back(LexToken(buffer, Tokens::KW_FOR, lineNum, lineCol - 1));
-                else _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol));
-                break;
-            case 4:
-                if(compare(buffer, "bool")) _dest->push_back(LexToken(buffer, Tokens::TYPE_BOOL, lineNum, lineCol - 1));
-                else if(compare(buffer, "byte")) _dest->push_back(LexToken(buffer, Tokens::TYPE_BYTE, lineNum, lineCol - 1));
-                else if(compare(buffer, "long")) _dest->push_back(LexToken(buffer, Tokens::TYPE_LONG, lineNum, lineCol - 1));
-                else if(compare(buffer, "char")) _dest->push_back(LexToken(buffer, Tokens::TYPE_CHAR, lineNum, lineCol - 1));
-                else if(compare(buffer, "void")) _dest->push_back(LexToken(buffer, Tokens::TYPE_VOID, lineNum, lineCol - 1));
-                else if(compare(buffer, "else")) _dest->push_back(LexToken(buffer, Tokens::KW_ELSE, lineNum, lineCol - 1));
-                else if(compare(buffer, "enum")) _dest->push_back(LexToken(buffer, Tokens::KW_ENUM, lineNum, lineCol - 1));
-                else if(compare(buffer, "case")) _dest->push_back(LexToken(buffer, Tokens::KW_CASE, lineNum, lineCol - 1));
-                else _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol - 1));
-                break;
-            case 5:
-                if(compare(buffer, "short")) _dest->push_back(LexToken(buffer, Tokens::TYPE_SHORT, lineNum, lineCol - 1));
-                else if(compare(buffer, "class")) _dest->push_back(LexToken(buffer, Tokens::KW_CLASS, lineNum, lineCol - 1));
-                else if(compare(buffer, "const")) _dest->push_back(LexToken(buffer, Tokens::KW_CONST, lineNum, lineCol - 1));
-                else if(compare(buffer, "break")) _dest->push_back(LexToken(buffer, Tokens::KW_BREAK, lineNum, lineCol - 1));
-                else if(compare(buffer, "while")) _dest->push_back(LexToken(buffer, Tokens::KW_WHILE, lineNum, lineCol - 1));
-                else _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol - 1));
-                break;
-            case 6:
-                if(compare(buffer, "uint32")) _dest->push_back(LexToken(buffer, Tokens::TYPE_UINT32, lineNum, lineCol - 1));
-                else if(compare(buffer, "uint64")) _dest->push_back(LexToken(buffer, Tokens::TYPE_UINT64, lineNum, lineCol - 1));
-                else if(compare(buffer, "double")) _dest->push_back(LexToken(buffer, Tokens::TYPE_DOUBLE, lineNum, lineCol - 1));
-                else if(compare(buffer, "string")) _dest->push_back(LexToken(buffer, Tokens::STRING, lineNum, lineCol - 1));
-                else if(compare(buffer, "public")) _dest->push_back(LexToken(buffer, Tokens::KW_PUBLIC, lineNum, lineCol - 1));
-                else if(compare(buffer, "return")) _dest->push_back(LexToken(buffer, Tokens::KW_RETURN, lineNum, lineCol - 1));
-                else if(compare(buffer, "switch")) _dest->push_back(LexToken(buffer, Tokens::KW_SWITCH, lineNum, lineCol - 1));
-                else _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol - 1));
-                break;
-            case 7:
-                if(compare(buffer, "uint128")) _dest->push_back(LexToken(buffer, Tokens::TYPE_UINT128, lineNum, lineCol - 1));
-                else if(compare(buffer, "uint256")) _dest->push_back(LexToken(buffer, Tokens::TYPE_UINT256, lineNum, lineCol - 1));
-                else if(compare(buffer, "extends")) _dest->push_back(LexToken(buffer, Tokens::KW_EXTENDS, lineNum, lineCol - 1));
-                else if(compare(buffer, "private")) _dest->push_back(LexToken(buffer, Tokens::KW_PRIVATE, lineNum, lineCol - 1));
-                else if(compare(buffer, "default")) _dest->push_back(LexToken(buffer, Tokens::KW_DEFAULT, lineNum, lineCol - 1));
-                else _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol - 1));
-                break;
-            case 8:
-                if(compare(buffer, "waddress")) _dest->push_back(LexToken(buffer, Tokens::TYPE_WADDRESS, lineNum, lineCol - 1));
-                else if(compare(buffer, "continue")) _dest->push_back(LexToken(buffer, Tokens::KW_CONTINUE, lineNum, lineCol - 1));
-                else _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol - 1));
-                break;
-            default:
-                _dest->push_back(LexToken(buffer, Tokens::ID, lineNum, lineCol - 1));
-            }
-            buffer = {};
+            emitToken(_dest, lexKeyword(buffer.data(), buffer.size()), tokenLine, tokenCol);
+            buffer.clear();
             goto SELECT_NEXT;
         }
     }
@@ -517,11 +1141,11 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
     {
         parsingState = "Miscellaneous lexing";
         buffer.push_back(currentByte);
-        if(currentByte == ',') _dest->push_back(LexToken(buffer, Tokens::MES_COMMA, lineNum, lineCol));
-        else if(currentByte == ';') _dest->push_back(LexToken(buffer, Tokens::MES_SEMI, lineNum, lineCol));
-        else if(currentByte == ':') _dest->push_back(LexToken(buffer, Tokens::MES_COLON, lineNum, lineCol));
+        if(currentByte == ',') emitToken(_dest, Tokens::MES_COMMA, tokenLine, tokenCol);
+        else if(currentByte == ';') emitToken(_dest, Tokens::MES_SEMI, tokenLine, tokenCol);
+        else if(currentByte == ':') emitToken(_dest, Tokens::MES_COLON, tokenLine, tokenCol);
         else goto ERROR;
-        buffer = {};
+        buffer.clear();
         getNextByte();
         goto SELECT_NEXT;
     }
@@ -530,14 +1154,14 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
     {
         buffer.push_back(currentByte);
         parsingState = "Brackets lexing";
-        if(currentByte == '{') _dest->push_back(LexToken(buffer, Tokens::BRACE_L, lineNum, lineCol));
-        else if(currentByte == '}') _dest->push_back(LexToken(buffer, Tokens::BRACE_R, lineNum, lineCol));
-        else if(currentByte == '(') _dest->push_back(LexToken(buffer, Tokens::BRKT_L, lineNum, lineCol));
-        else if(currentByte == ')') _dest->push_back(LexToken(buffer, Tokens::BRKT_R, lineNum, lineCol));
-        else if(currentByte == '[') _dest->push_back(LexToken(buffer, Tokens::SQBRKT_L, lineNum, lineCol));
-        else if(currentByte == ']') _dest->push_back(LexToken(buffer, Tokens::SQBRKT_R, lineNum, lineCol));
+        if(currentByte == '{') emitToken(_dest, Tokens::BRACE_L, tokenLine, tokenCol);
+        else if(currentByte == '}') emitToken(_dest, Tokens::BRACE_R, tokenLine, tokenCol);
+        else if(currentByte == '(') emitToken(_dest, Tokens::BRKT_L, tokenLine, tokenCol);
+        else if(currentByte == ')') emitToken(_dest, Tokens::BRKT_R, tokenLine, tokenCol);
+        else if(currentByte == '[') emitToken(_dest, Tokens::SQBRKT_L, tokenLine, tokenCol);
+        else if(currentByte == ']') emitToken(_dest, Tokens::SQBRKT_R, tokenLine, tokenCol);
         else goto ERROR;
-        buffer = {};
+        buffer.clear();
         getNextByte();
         goto SELECT_NEXT;
     }
@@ -552,16 +1176,16 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
             if(isOperator(currentByte)) goto ERROR;
             if(buffer[0] == '.' && isNumber(currentByte))
             {
-                buffer = {};
+                buffer.clear();
                 ungetByte();
                 // buffer.push_back(currentByte);
                 goto NUMBERDOT;
             }
-            if(buffer[0] == '^') _dest->push_back(LexToken(buffer, Tokens::OP_B_XOR, lineNum, lineCol));
-            else if(buffer[0] == '~') _dest->push_back(LexToken(buffer, Tokens::OP_B_NOT, lineNum, lineCol));
-            else if(buffer[0] == '.') _dest->push_back(LexToken(buffer, Tokens::OP_DOT, lineNum, lineCol));
+            if(buffer[0] == '^') emitToken(_dest, Tokens::OP_B_XOR, tokenLine, tokenCol);
+            else if(buffer[0] == '~') emitToken(_dest, Tokens::OP_B_NOT, tokenLine, tokenCol);
+            else if(buffer[0] == '.') emitToken(_dest, Tokens::OP_DOT, tokenLine, tokenCol);
             else goto ERROR;
-            buffer = {};
+            buffer.clear();
             goto SELECT_NEXT;
         }
         getNextByte();
@@ -569,212 +1193,237 @@ void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
         {
             buffer.push_back(currentByte);
             if(buffer[0] == '=' && buffer[1] == '=')
-                _dest->push_back(LexToken(buffer, Tokens::OP_EQL, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_EQL, tokenLine, tokenCol);
             else if(buffer[0] == '-' && buffer[1] == '=')
-                _dest->push_back(LexToken(buffer, Tokens::OP_MINUSASSIGN, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_MINUSASSIGN, tokenLine, tokenCol);
             else if(buffer[0] == '+' && buffer[1] == '=')
-                _dest->push_back(LexToken(buffer, Tokens::OP_PLUSASSIGN, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_PLUSASSIGN, tokenLine, tokenCol);
             else if(buffer[0] == '*' && buffer[1] == '=')
-                _dest->push_back(LexToken(buffer, Tokens::OP_MULASSIGN, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_MULASSIGN, tokenLine, tokenCol);
             else if(buffer[0] == '/' && buffer[1] == '=')
-                _dest->push_back(LexToken(buffer, Tokens::OP_DIVASSIGN, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_DIVASSIGN, tokenLine, tokenCol);
             else if(buffer[0] == '%' && buffer[1] == '=')
-                _dest->push_back(LexToken(buffer, Tokens::OP_MODASSIGN, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_MODASSIGN, tokenLine, tokenCol);
             else if(buffer[0] == '+' && buffer[1] == '+')
-                _dest->push_back(LexToken(buffer, Tokens::OP_INC, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_INC, tokenLine, tokenCol);
             else if(buffer[0] == '-' && buffer[1] == '-')
-                _dest->push_back(LexToken(buffer, Tokens::OP_DEC, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_DEC, tokenLine, tokenCol);
             else if(buffer[0] == '>' && buffer[1] == '>')
-                _dest->push_back(LexToken(buffer, Tokens::OP_B_SHFTR, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_B_SHFTR, tokenLine, tokenCol);
             else if(buffer[0] == '<' && buffer[1] == '<')
-                _dest->push_back(LexToken(buffer, Tokens::OP_B_SHFTL, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_B_SHFTL, tokenLine, tokenCol);
             else if(buffer[0] == '>' && buffer[1] == '=')
-                _dest->push_back(LexToken(buffer, Tokens::OP_BGEQ, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_BGEQ, tokenLine, tokenCol);
             else if(buffer[0] == '<' && buffer[1] == '=')
-                _dest->push_back(LexToken(buffer, Tokens::OP_LSEQ, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_LSEQ, tokenLine, tokenCol);
             else if(buffer[0] == '&' && buffer[1] == '&')
-                _dest->push_back(LexToken(buffer, Tokens::OP_AND, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_AND, tokenLine, tokenCol);
             else if(buffer[0] == '|' && buffer[1] == '|')
-                _dest->push_back(LexToken(buffer, Tokens::OP_OR, lineNum, lineCol));
+                emitToken(_dest, Tokens::OP_OR, tokenLine, tokenCol);
             else if(buffer[0] == '/' && buffer[1] == '*')
             {
-                lineBuffer = {};
-                buffer = {};
+                lineBuffer.clear();
+                buffer.clear();
+                commentSize = 2;
                 goto COMMENT;
             }
             else goto ERROR;
 
-            buffer = {};
+            buffer.clear();
             getNextByte();
             goto SELECT_NEXT;
         }
         else
         {
-            if(buffer[0] == '=') _dest->push_back(LexToken(buffer, Tokens::OP_ASSIGN, lineNum, lineCol));
-            else if(buffer[0] == '+') _dest->push_back(LexToken(buffer, Tokens::OP_PLUS, lineNum, lineCol));
-            else if(buffer[0] == '-') _dest->push_back(LexToken(buffer, Tokens::OP_MINUS, lineNum, lineCol));
-            else if(buffer[0] == '*') _dest->push_back(LexToken(buffer, Tokens::OP_MUL, lineNum, lineCol));
-            else if(buffer[0] == '/') _dest->push_back(LexToken(buffer, Tokens::OP_DIV, lineNum, lineCol));
-            else if(buffer[0] == '%') _dest->push_back(LexToken(buffer, Tokens::OP_MOD, lineNum, lineCol));
-            else if(buffer[0] == '^') _dest->push_back(LexToken(buffer, Tokens::OP_B_XOR, lineNum, lineCol));
-            else if(buffer[0] == '~') _dest->push_back(LexToken(buffer, Tokens::OP_B_NOT, lineNum, lineCol));
-            else if(buffer[0] == '&') _dest->push_back(LexToken(buffer, Tokens::OP_B_AND, lineNum, lineCol));
-            else if(buffer[0] == '|') _dest->push_back(LexToken(buffer, Tokens::OP_B_OR, lineNum, lineCol));
-            else if(buffer[0] == '>') _dest->push_back(LexToken(buffer, Tokens::OP_BIGGER, lineNum, lineCol));
-            else if(buffer[0] == '<') _dest->push_back(LexToken(buffer, Tokens::OP_LESS, lineNum, lineCol));
-            else if(buffer[0] == '.') _dest->push_back(LexToken(buffer, Tokens::OP_DOT, lineNum, lineCol));
+            if(buffer[0] == '=') emitToken(_dest, Tokens::OP_ASSIGN, tokenLine, tokenCol);
+            else if(buffer[0] == '+') emitToken(_dest, Tokens::OP_PLUS, tokenLine, tokenCol);
+            else if(buffer[0] == '-') emitToken(_dest, Tokens::OP_MINUS, tokenLine, tokenCol);
+            else if(buffer[0] == '*') emitToken(_dest, Tokens::OP_MUL, tokenLine, tokenCol);
+            else if(buffer[0] == '/') emitToken(_dest, Tokens::OP_DIV, tokenLine, tokenCol);
+            else if(buffer[0] == '%') emitToken(_dest, Tokens::OP_MOD, tokenLine, tokenCol);
+            else if(buffer[0] == '^') emitToken(_dest, Tokens::OP_B_XOR, tokenLine, tokenCol);
+            else if(buffer[0] == '~') emitToken(_dest, Tokens::OP_B_NOT, tokenLine, tokenCol);
+            else if(buffer[0] == '&') emitToken(_dest, Tokens::OP_B_AND, tokenLine, tokenCol);
+            else if(buffer[0] == '|') emitToken(_dest, Tokens::OP_B_OR, tokenLine, tokenCol);
+            else if(buffer[0] == '>') emitToken(_dest, Tokens::OP_BIGGER, tokenLine, tokenCol);
+            else if(buffer[0] == '<') emitToken(_dest, Tokens::OP_LESS, tokenLine, tokenCol);
+            else if(buffer[0] == '.') emitToken(_dest, Tokens::OP_DOT, tokenLine, tokenCol);
             else goto ERROR;
 
-            buffer = {};
+            buffer.clear();
             goto SELECT_NEXT;
         }
     }
 
-    //TO DO utf-8 support
     STRING:
     {
         parsingState = "Parsing string";
-        if(currentByte == '\n') 
-        {
-            lineNum++;
-            lineCol = 0;
-            lineBuffer = {};
-        }
-        if(currentByte == '\'' && !isString)
-        {
-            if(isChar)
-            {
-                _dest->push_back(LexToken(buffer, Tokens::CHAR, lineNum, lineCol));
-                buffer = {};
-                getNextByte();
-                isChar = false;
-                goto SELECT_NEXT;
-            }
-            else
-            {
-                isChar = true;
-                getNextByte();
-                goto STRING;
-            }
-        }
-        else if(currentByte == '"' && !isChar)
+        quote = currentByte;
+        literals.begin();
+        charSymbols = {};
+        goto STRING_BODY;
+    }
+
+    STRING_BODY:
+    {
+        //plain bytes are copied by runs, only quote, '\\' and '\n' are handled here
+        scanLiteralRun(quote);
+        getNextByte();
+        if(currentByte == quote)
         {
-            if(isString)
+            if(quote == '"')
             {
-                _dest->push_back(LexToken(buffer, Tokens::STRING, lineNum, lineCol));
-                buffer = {};
-                getNextByte();
-                isString = false;
-                goto SELECT_NEXT;
+                emitLiteral(_dest, Tokens::STRING, tokenLine, tokenCol);
             }
             else
             {
-                isString = true;
-                getNextByte();
-                goto STRING;
-            }
-        }
-        else if(currentByte != EOF)
-        {
-            buffer.push_back(currentByte);
-            if(isChar)
-            {
-                if(buffer.size() > 2)
+                LexLiteralError error = charSymbols.check();
+                if(error != LITERAL_OK)
                 {
-                    parsingState = "Char must be only one symbol";
+                    parsingState = stringLiteralErrors[error];
                     goto ERROR;
                 }
-                if(buffer.size() == 2)
-                {
-                    if(buffer[0] != '\\')
-                    {
-                        parsingState = "Char must be only one symbol";
-                        goto ERROR;
-                    }
-                }
+                emitLiteral(_dest, Tokens::CHAR, tokenLine, tokenCol);
             }
             getNextByte();
-            goto STRING;
+            goto SELECT_NEXT;
         }
-        goto ERROR;
+        if(currentByte == EOF)
+        {
+            parsingState = stringLiteralErrors[quote == '"' ? LITERAL_UNTERMINATED_STRING : LITERAL_UNTERMINATED_CHAR];
+            goto ERROR;
+        }
+        if(currentByte == '\\')
+        {
+            if(!decodeEscape()) goto ERROR;
+            charSymbols.escape();
+            goto STRING_BODY;
+        }
+        if(currentByte == '\n')
+        {
+            lineNum++;
+            lineCol = 0;
+            lineBuffer.clear();
+        }
+        //new line or end of input block
+        if(quote == '\'') charSymbols.raw(currentByte);
+        literals.push(currentByte);
+        goto STRING_BODY;
     }
 
     COMMENT:
     {
         parsingState = "Parsing comment";
         getNextByte();
-        buffer.push_back(currentByte);
-        if(buffer[0] == '*') 
+        commentSize++;
+        if(currentByte == '*') 
         {
             getNextByte();
-            buffer.push_back(currentByte);
-            if(buffer[1] == '/')
+            commentSize++;
+            if(currentByte == '/')
             {
                 //end of comment
-                lineBuffer = {};
-                buffer = {};
+                emitComment(_dest, commentSize);
+                lineBuffer.clear();
                 getNextByte();
                 goto SELECT_NEXT;
             }
-            else
-            {
-                ungetByte();
-                buffer = {};
-                goto COMMENT;
-            }
+            ungetByte();
+            commentSize--;
+            goto COMMENT;
         }
-        if(isSpace(currentByte)) {
-            if(currentByte == '\n')
-            {
-                lineNum++;
-                lineCol = 0;
-            }
+        if(currentByte == '\n')
+        {
+            lineNum++;
+            lineCol = 0;
+        }
+        if(currentByte == EOF)
+        {
+            parsingState = "Unterminated comment";
+            goto ERROR;
         }
-        buffer = {};
         goto COMMENT;
     }
 
     AUTOMATA_END:
     {
-        std::cout << "Lines: " << lineNum << "\n";
-        for (size_t i = 0; i < _dest->size(); i++)
-        {
-            std::cout << "[" << i << "]: ";
-            std::cout << "\033[33m";
-            for (size_t j = 0; j < (*_dest)[i].getData().size(); j++)
-            {
-                std::cout << (*_dest)[i].getData()[j];
-            }
-            std::cout << "\033[39m";
-            std::cout << "; Type: " << "\033[32m" << stringTokens[(*_dest)[i].getType()] << "\033[39m" << "; (";
-            std::cout << (*_dest)[i].getLn() << ", " << (*_dest)[i].getCol() << ")\n";
-            // std::cout << "Ln: " << "\033[32m" << (*_dest)[i].getLn() << "\033[39m" << "; ";
-            // std::cout << "Col: " << "\033[32m" << (*_dest)[i].getCol() << "\033[39m" << ";\n";
-        }
-        return;
+        return true;
     }
 
     ERROR:
     {
-        std::cout << "Error at state: " << parsingState << "!\n";
-        std::cout << "Error at: (Ln " << lineNum << ", Col " << lineCol << ")!\n\n";
-        std::cout << "\033[31m";
+        if(!keepLine)
+        {
+            //rebuild current line from the block: lineCol bytes up to inPos, earlier part was kept by refill()
+            size_t keep = (size_t)lineCol < inPos ? lineCol : inPos;
+            if((size_t)lineCol <= inPos) lineBuffer.clear();
+            lineBuffer.insert(lineBuffer.end(), input + inPos - keep, input + inPos);
+        }
+        std::ostringstream err;
+        err << "Error at state: " << parsingState << "!\n";
+        err << "Error at: (Ln " << lineNum << ", Col " << lineCol << ")!\n\n";
+        err << "\033[31m";
         for (size_t i = 0; i < lineBuffer.size(); i++)
         {
-            // if(i <= lineCol-1 && i >= lineCol - buffer.size()-1) std::cout << "\033[31m";
-            // else std::cout << "\033[39m";
-            std::cout << lineBuffer[i];
+            // if(i <= lineCol-1 && i >= lineCol - buffer.size()-1) err << "\033[31m";
+            // else err << "\033[39m";
+            err << lineBuffer[i];
         }
-        std::cout << "\n";
+        err << "\n";
         for (size_t i = 0; i < lineBuffer.size(); i++)
         {
-            if(i < lineCol-1 && i >= lineCol - buffer.size()-1) std::cout << "~";
-            else if(i == lineCol - 1) std::cout << "\033[31m" << "^";
-            else std::cout << " ";
+            if(i < lineCol-1 && i >= lineCol - buffer.size()-1) err << "~";
+            else if(i == lineCol - 1) err << "\033[31m" << "^";
+            else err << " ";
         }
-        std::cout << " Unexpected token!\n\n";
+        err << " Unexpected token!\n\n";
+        lastError = err.str();
+        return false;
     }
     
 }
 
-#endif
\ No newline at end of file
+bool LexAutomata::scanStats(LexStats *_stats)
+{
+    unsigned long long before = inTotal;
+    long linesBefore = lineNum;
+    //token scans after this one need lineBuffer again, whatever way scanInto leaves
+    struct KeepLineGuard
+    {
+        bool* keepLine;
+        ~KeepLineGuard() {*keepLine = true;}
+    } guard{&keepLine};
+    keepLine = false;
+    bool ok = scanInto(_stats);
+    //number of '\n' plus unterminated last line, empty input has no lines
+    _stats->lines += lineNum - linesBefore;
+    if(inTotal != before && lastInputByte != '\n') _stats->lines++;
+    _stats->bytes += inTotal - before;
+    return ok;
+}
+
+void LexAutomata::scanTokens(std::vector<LexToken> *_dest)
+{
+    if(!scanInto(_dest))
+    {
+        std::cout << lastError;
+        return;
+    }
+    std::cout << "Lines: " << lineNum << "\n";
+    for (size_t i = 0; i < _dest->size(); i++)
+    {
+        std::cout << "[" << i << "]: ";
+        std::cout << "\033[33m";
+        for (size_t j = 0; j < (*_dest)[i].getData().size(); j++)
+        {
+            std::cout << (*_dest)[i].getData()[j];
+        }
+        std::cout << "\033[39m";
+        std::cout << "; Type: " << "\033[32m" << stringTokens[(*_dest)[i].getType()] << "\033[39m" << "; (";
+        std::cout << (*_dest)[i].getLn() << ", " << (*_dest)[i].getCol() << ")\n";
+        // std::cout << "Ln: " << "\033[32m" << (*_dest)[i].getLn() << "\033[39m" << "; ";
+        // std::cout << "Col: " << "\033[32m" << (*_dest)[i].getCol() << "\033[39m" << ";\n";
+    }
+}
+
+#endif
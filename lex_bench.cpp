@@ -0,0 +1,281 @@
+/**
+ * @file lex_bench.cpp
+ * @brief benchmarks for lexer modes
+ * @version 1.0
+ *
+ */
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include "lex_automata.hpp"
+#include "lex_pipeline.hpp"
+#include "lex_decompress.hpp"
+#include "lex_constexpr.hpp"
+
+typedef std::chrono::steady_clock benchClock;
+
+/**
+ * @brief writes synthetic Theia source of approximately _lines lines
+ *
+ * @param _path output path
+ * @param _lines number of lines
+ */
+void writeSource(std::string _path, long _lines)
+{
+    std::ofstream out(_path, std::ios::binary);
+    for (long i = 0; i < _lines; i += 8)
+    {
+        out << "class Item" << i << " extends Base {\n";
+        out << "    public int count = " << i << " + offset * 3;\n";
+        out << "    private double ratio = 1.5e3;\n";
+        out << "    /* state of the item */\n";
+        out << "    string name = \"item number\"; char c = 'x';\n";
+        out << "    while(count) { count -= 1; total += count; }\n";
+        out << "    return value.field;\n";
+        out << "}\n";
+    }
+}
+
+/**
+ * @brief dummy parser work per token (hashes token bytes a few rounds)
+ *
+ */
+struct DummyConsumer
+{
+    uint64_t hash = 1469598103934665603ull;
+    size_t count = 0;
+    int rounds;
+    DummyConsumer(int _rounds) : rounds(_rounds) {}
+    inline void operator()(LexToken& _t)
+    {
+        bytes data = _t.getData();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (size_t i = 0; i < data.size(); i++) hash = (hash ^ data[i]) * 1099511628211ull;
+            hash ^= (uint64_t)_t.getType() + (uint64_t)r;
+        }
+        count++;
+    }
+};
+
+inline double msSince(benchClock::time_point _from)
+{
+    return std::chrono::duration<double, std::milli>(benchClock::now() - _from).count();
+}
+
+void benchPipeline(std::string _path, int _rounds)
+{
+    std::cout << "== pipeline (consumer rounds: " << _rounds << ") ==\n";
+
+    if(std::thread::hardware_concurrency() < 2)
+    {
+        std::cout << "single hardware thread: pipelined times can not show overlap here\n";
+    }
+
+    double lexMs, consumeMs;
+    DummyConsumer seq(_rounds);
+    {
+        //untimed count pass, so the baseline does not pay for vector reallocation
+        LexStats count;
+        {
+            LexAutomata counter(_path);
+            counter.scanStats(&count);
+        }
+        LexAutomata lex(_path);
+        std::vector<LexToken> tokens;
+        tokens.reserve(count.tokens);
+        benchClock::time_point t0 = benchClock::now();
+        if(!lex.scanInto(&tokens))
+        {
+            std::cout << lex.getLastError();
+            return;
+        }
+        lexMs = msSince(t0);
+        t0 = benchClock::now();
+        for (size_t i = 0; i < tokens.size(); i++) seq(tokens[i]);
+        consumeMs = msSince(t0);
+    }
+    std::cout << "sequential: lex " << lexMs << " ms + consume " << consumeMs << " ms = " << lexMs + consumeMs << " ms\n";
+
+    const char* names[3] = {"spin", "yield", "block"};
+    LexWaitPolicy policies[3] = {LexWaitPolicy::WAIT_SPIN, LexWaitPolicy::WAIT_YIELD, LexWaitPolicy::WAIT_BLOCK};
+    for (int p = 0; p < 3; p++)
+    {
+        //spinning makes no sense without a second core
+        if(policies[p] == LexWaitPolicy::WAIT_SPIN && std::thread::hardware_concurrency() < 2) continue;
+        LexAutomata lex(_path);
+        DummyConsumer cons(_rounds);
+        benchClock::time_point t0 = benchClock::now();
+        LexPipeline pipe(&lex, 4096, 64, policies[p]);
+        pipe.start();
+        while(pipe.drain(cons) != 0) {}
+        pipe.join();
+        double ms = msSince(t0);
+        if(pipe.failed()) std::cout << pipe.getError();
+        std::cout << "pipelined (" << names[p] << "): " << ms << " ms";
+        std::cout << (cons.hash == seq.hash && cons.count == seq.count ? "" : " [MISMATCH]") << "\n";
+    }
+}
+
+/**
+ * @brief sink that drops tokens, to time lexing alone
+ *
+ */
+struct NullSink
+{
+    size_t count = 0;
+    inline void push_back(LexToken&&) {count++;}
+};
+
+#if defined(LEX_HAVE_ZLIB)
+void benchDecompress(std::string _path)
+{
+    std::cout << "== gzip input ==\n";
+    std::string gzPath = _path + ".gz";
+    {
+        FILE* src = fopen(_path.c_str(), "rb");
+        gzFile gz = gzopen(gzPath.c_str(), "wb6");
+        bytes chunk(LEX_INPUT_BLOCK);
+        size_t n;
+        while((n = fread(chunk.data(), 1, chunk.size(), src)) != 0) gzwrite(gz, chunk.data(), n);
+        gzclose(gz);
+        fclose(src);
+    }
+
+    double decompressMs, lexMs, streamMs;
+    size_t plainTokens, streamTokens;
+    {
+        benchClock::time_point t0 = benchClock::now();
+        LexDecompressSource source(gzPath);
+        const unsigned char* data;
+        while(source.nextBlock(&data) != 0) {}
+        decompressMs = msSince(t0);
+    }
+    {
+        LexAutomata lex(_path);
+        NullSink sink;
+        benchClock::time_point t0 = benchClock::now();
+        lex.scanInto(&sink);
+        lexMs = msSince(t0);
+        plainTokens = sink.count;
+    }
+    {
+        benchClock::time_point t0 = benchClock::now();
+        LexDecompressSource source(gzPath);
+        LexAutomata lex(&source);
+        NullSink sink;
+        if(!lex.scanInto(&sink)) std::cout << lex.getLastError();
+        streamMs = msSince(t0);
+        streamTokens = sink.count;
+    }
+    std::cout << "decompress only: " << decompressMs << " ms, lex plain: " << lexMs << " ms\n";
+    std::cout << "lex from gzip: " << streamMs << " ms (sum " << decompressMs + lexMs;
+    std::cout << " ms, max " << (decompressMs > lexMs ? decompressMs : lexMs) << " ms)";
+    std::cout << (plainTokens == streamTokens ? "" : " [MISMATCH]") << "\n";
+    std::remove(gzPath.c_str());
+}
+#endif
+
+void benchPipe(std::string _path)
+{
+    std::cout << "== pipe input ==\n";
+    bytes content;
+    {
+        FILE* f = fopen(_path.c_str(), "rb");
+        bytes chunk(LEX_INPUT_BLOCK);
+        size_t n;
+        while((n = fread(chunk.data(), 1, chunk.size(), f)) != 0) content.insert(content.end(), chunk.begin(), chunk.begin() + n);
+        fclose(f);
+    }
+
+    double fileMs, pipeMs;
+    LexStats fileStats, pipeStats;
+    {
+        LexAutomata lex(_path);
+        benchClock::time_point t0 = benchClock::now();
+        lex.scanStats(&fileStats);
+        fileMs = msSince(t0);
+    }
+    {
+        int fds[2];
+        if(pipe(fds) != 0)
+        {
+            std::cout << "pipe() failed\n";
+            return;
+        }
+        benchClock::time_point t0 = benchClock::now();
+        std::thread writer([&] {
+            size_t off = 0;
+            while(off < content.size())
+            {
+                ssize_t w = write(fds[1], content.data() + off, content.size() - off);
+                if(w <= 0) break;
+                off += w;
+            }
+            close(fds[1]);
+        });
+        {
+            LexPipeSource source(fds[0], true);
+            LexAutomata lex(&source);
+            if(!lex.scanStats(&pipeStats)) std::cout << lex.getLastError();
+        }
+        writer.join();
+        pipeMs = msSince(t0);
+    }
+    std::cout << "file: " << fileMs << " ms, pipe: " << pipeMs << " ms";
+    std::cout << (fileStats.tokens == pipeStats.tokens && fileStats.bytes == pipeStats.bytes ? "" : " [MISMATCH]") << "\n";
+}
+
+#define EMBEDDED_SOURCE \
+    "class Prelude extends Object {\n" \
+    "    public string greet = \"hello\\tworld\\u{21}\";\n" \
+    "    private double eps = 1.0e-9;\n" \
+    "    /* counters */\n" \
+    "    int count = 0; char sep = ',';\n" \
+    "    while(count) { count -= 1; }\n" \
+    "}\n"
+
+constexpr auto embeddedPrelude = lexEmbedded<EMBEDDED_SOURCE>();
+
+void benchEmbedded()
+{
+    std::cout << "== embedded source ==\n";
+    const int runs = 1000;
+    size_t tokens = 0;
+    benchClock::time_point t0 = benchClock::now();
+    for (int r = 0; r < runs; r++)
+    {
+        const char src[] = EMBEDDED_SOURCE;
+        FILE* f = fmemopen((void*)src, sizeof(src) - 1, "rb");
+        {
+            LexAutomata lex(f);
+            std::vector<LexToken> out;
+            lex.scanInto(&out);
+            tokens = out.size();
+        }
+        fclose(f);
+    }
+    double ms = msSince(t0);
+    std::cout << "runtime lex: " << ms * 1000.0 / runs << " us per launch, " << tokens << " tokens\n";
+    std::cout << "constexpr: 0 us, " << embeddedPrelude.tokens.size() << " tokens";
+    std::cout << (tokens == embeddedPrelude.tokens.size() ? "" : " [MISMATCH]") << "\n";
+}
+
+int main(int argc, char** argv)
+{
+    long lines = argc > 1 ? std::stol(argv[1]) : 400000;
+    std::string path = "lex_bench_input.theia";
+    writeSource(path, lines);
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+
+    benchPipeline(path, 8);
+#if defined(LEX_HAVE_ZLIB)
+    benchDecompress(path);
+#endif
+    benchPipe(path);
+    benchEmbedded();
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,420 @@
+/**
+ * @file lex_constexpr.hpp
+ * @brief constexpr lexing of embedded Theia sources into std::array of compact tokens
+ * @version 1.0
+ *
+ * Usage:
+ *     constexpr auto prelude = lexEmbedded<"class A { int x = 1; }">();
+ *     static_assert(prelude.tokens[0].type == Tokens::KW_CLASS);
+ *     std::string_view name = prelude.text(prelude.tokens[1]); // "A"
+ *
+ * Keywords, escapes, UTF-8 encoding and char checks are the shared helpers of
+ * lex_automata.hpp, so rules are the same as in LexAutomata. A source that does
+ * not lex fails to compile with LexEmbeddedError<error, literal error, line, col>
+ * in the diagnostic.
+ */
+#ifndef LEX_CONSTEXPR_HPP
+#define LEX_CONSTEXPR_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include "lex_automata.hpp"
+
+/**
+ * @brief errors of constexpr lexing
+ *
+ */
+enum LexCtError {
+    CT_OK,
+    CT_UNEXPECTED_SYMBOL,
+    CT_BAD_NUMBER,
+    CT_BAD_OPERATOR,
+    CT_UNTERMINATED_COMMENT,
+    //STRING or CHAR, kind is in LexCtResult::literalError (messages in stringLiteralErrors)
+    CT_BAD_LITERAL,
+};
+
+const std::string_view stringCtErrors[6] = {
+    "OK",
+    "Unexpected symbol",
+    "Malformed number",
+    "Unknown operator",
+    "Unterminated comment",
+    "Malformed literal",
+};
+
+/**
+ * @brief token without own storage: text is [offset, offset + length) of source,
+ * or of decoded literal pool for STRING and CHAR.
+ * line and col are of the first byte of token, as LexToken::getLn()/getCol()
+ *
+ */
+struct LexCompactToken
+{
+    Tokens type;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t line;
+    uint32_t col;
+};
+
+/**
+ * @brief summary of constexpr scan
+ *
+ */
+struct LexCtResult
+{
+    size_t tokens = 0;
+    size_t literalBytes = 0;
+    LexCtError error = LexCtError::CT_OK;
+    LexLiteralError literalError = LITERAL_OK;
+    uint32_t errorLine = 0;
+    uint32_t errorCol = 0;
+};
+
+/**
+ * @brief string literal usable as template argument
+ *
+ * @tparam N size with terminating zero
+ */
+template<size_t N>
+struct LexFixedString
+{
+    char data[N];
+    constexpr LexFixedString(const char (&_s)[N])
+    {
+        for (size_t i = 0; i < N; i++) data[i] = _s[i];
+    }
+    constexpr size_t size() const {return N - 1;}
+};
+
+constexpr bool ctIsAlpha(int _c) {return (_c >= 'a' && _c <= 'z') || (_c >= 'A' && _c <= 'Z');}
+constexpr bool ctIsNumber(int _c) {return _c >= '0' && _c <= '9';}
+//same set as LexAutomata::isSpace
+constexpr bool ctIsSpace(int _c) {return _c >= 0 && (_c == ' ' || _c <= '\n' || _c == '\t' || _c == '\r' || _c == '\v');}
+constexpr bool ctIsOperator(int _c) {return _c == '=' || _c == '+' || _c == '-' || _c == '*' || _c == '/' || _c == '%' || _c == '&' || _c == '|' || _c == '^' || _c == '~' || _c == '.';}
+constexpr bool ctIsBrackets(int _c) {return _c == '{' || _c == '}' || _c == '(' || _c == ')' || _c == '[' || _c == ']';}
+
+/**
+ * @brief two-char operator or -1 if pair is unknown ("/_*" is handled by caller)
+ *
+ */
+constexpr int ctOperatorPair(int _a, int _b)
+{
+    if(_b == '=')
+    {
+        switch (_a)
+        {
+        case '=': return Tokens::OP_EQL;
+        case '-': return Tokens::OP_MINUSASSIGN;
+        case '+': return Tokens::OP_PLUSASSIGN;
+        case '*': return Tokens::OP_MULASSIGN;
+        case '/': return Tokens::OP_DIVASSIGN;
+        case '%': return Tokens::OP_MODASSIGN;
+        }
+        return -1;
+    }
+    if(_a != _b) return -1;
+    switch (_a)
+    {
+    case '+': return Tokens::OP_INC;
+    case '-': return Tokens::OP_DEC;
+    case '&': return Tokens::OP_AND;
+    case '|': return Tokens::OP_OR;
+    }
+    return -1;
+}
+
+constexpr Tokens ctOperator(int _c)
+{
+    switch (_c)
+    {
+    case '=': return Tokens::OP_ASSIGN;
+    case '+': return Tokens::OP_PLUS;
+    case '-': return Tokens::OP_MINUS;
+    case '*': return Tokens::OP_MUL;
+    case '/': return Tokens::OP_DIV;
+    case '%': return Tokens::OP_MOD;
+    case '^': return Tokens::OP_B_XOR;
+    case '~': return Tokens::OP_B_NOT;
+    case '&': return Tokens::OP_B_AND;
+    case '|': return Tokens::OP_B_OR;
+    default: return Tokens::OP_DOT;
+    }
+}
+
+constexpr Tokens ctSingle(int _c)
+{
+    switch (_c)
+    {
+    case '{': return Tokens::BRACE_L;
+    case '}': return Tokens::BRACE_R;
+    case '(': return Tokens::BRKT_L;
+    case ')': return Tokens::BRKT_R;
+    case '[': return Tokens::SQBRKT_L;
+    case ']': return Tokens::SQBRKT_R;
+    case ',': return Tokens::MES_COMMA;
+    case ';': return Tokens::MES_SEMI;
+    default: return Tokens::MES_COLON;
+    }
+}
+
+/**
+ * @brief constexpr FSM over _src. Works at runtime too.
+ * Out must provide:
+ *     constexpr void token(Tokens, uint32_t offset, uint32_t length, uint32_t line, uint32_t col)
+ *     constexpr void literal(unsigned char) - appends decoded byte to literal pool
+ *
+ * @param _src source
+ * @param _size source size
+ * @param _out output
+ */
+template<typename Out>
+constexpr LexCtResult lexConstexprScan(const char* _src, size_t _size, Out& _out)
+{
+    LexCtResult r;
+    size_t i = 0;
+    size_t lineStart = 0;
+    uint32_t line = 1;
+    auto at = [&](size_t _k) -> int {return _k < _size ? (unsigned char)_src[_k] : -1;};
+    auto fail = [&](LexCtError _e, size_t _pos) {
+        r.error = _e;
+        r.errorLine = line;
+        r.errorCol = _pos - lineStart + 1;
+        return r;
+    };
+    auto failLiteral = [&](LexLiteralError _e, size_t _pos) {
+        r.literalError = _e;
+        return fail(LexCtError::CT_BAD_LITERAL, _pos);
+    };
+    auto emit = [&](Tokens _type, size_t _offset, size_t _length, size_t _start) {
+        _out.token(_type, _offset, _length, line, _start - lineStart + 1);
+        r.tokens++;
+    };
+
+    while(i < _size)
+    {
+        int c = at(i);
+        size_t start = i;
+        if(c == '\n')
+        {
+            line++;
+            lineStart = ++i;
+            continue;
+        }
+        if(ctIsSpace(c))
+        {
+            i++;
+            continue;
+        }
+        if(ctIsAlpha(c))
+        {
+            while(ctIsAlpha(at(i)) || ctIsNumber(at(i))) i++;
+            emit(lexKeyword(_src + start, i - start), start, i - start, start);
+            continue;
+        }
+        if(ctIsNumber(c) || (c == '.' && ctIsNumber(at(i + 1))))
+        {
+            Tokens type = Tokens::NUMBER;
+            while(ctIsNumber(at(i))) i++;
+            if(at(i) == '.')
+            {
+                if(!ctIsNumber(at(++i))) return fail(LexCtError::CT_BAD_NUMBER, i);
+                type = Tokens::FLNUMBER;
+                while(ctIsNumber(at(i))) i++;
+                if(at(i) == 'e' || at(i) == 'E')
+                {
+                    bool signedExponent = false;
+                    i++;
+                    while(true)
+                    {
+                        if(ctIsNumber(at(i))) i++;
+                        else if(at(i) == '-' && !signedExponent)
+                        {
+                            signedExponent = true;
+                            if(!ctIsNumber(at(++i))) return fail(LexCtError::CT_BAD_NUMBER, i);
+                        }
+                        else break;
+                    }
+                }
+            }
+            if(ctIsAlpha(at(i))) return fail(LexCtError::CT_BAD_NUMBER, i);
+            emit(type, start, i - start, start);
+            continue;
+        }
+        if(ctIsOperator(c))
+        {
+            int next = at(i + 1);
+            if(c == '^' || c == '~' || c == '.')
+            {
+                if(ctIsOperator(next)) return fail(LexCtError::CT_BAD_OPERATOR, i + 1);
+                emit(ctOperator(c), start, 1, start);
+                i++;
+                continue;
+            }
+            if(!ctIsOperator(next))
+            {
+                emit(ctOperator(c), start, 1, start);
+                i++;
+                continue;
+            }
+            if(c == '/' && next == '*')
+            {
+                i += 2;
+                while(!(at(i) == '*' && at(i + 1) == '/'))
+                {
+                    if(at(i) == -1) return fail(LexCtError::CT_UNTERMINATED_COMMENT, start);
+                    if(at(i) == '\n')
+                    {
+                        line++;
+                        lineStart = i + 1;
+                    }
+                    i++;
+                }
+                i += 2;
+                continue;
+            }
+            int pair = ctOperatorPair(c, next);
+            if(pair < 0) return fail(LexCtError::CT_BAD_OPERATOR, i + 1);
+            emit((Tokens)pair, start, 2, start);
+            i += 2;
+            continue;
+        }
+        if(ctIsBrackets(c) || c == ',' || c == ';' || c == ':')
+        {
+            emit(ctSingle(c), start, 1, start);
+            i++;
+            continue;
+        }
+        if(c == '"' || c == '\'')
+        {
+            size_t literalStart = r.literalBytes;
+            uint32_t startLine = line;
+            size_t startCol = start - lineStart + 1;
+            LexCharSymbols charSymbols;
+            auto push = [&](unsigned _b) {
+                _out.literal((unsigned char)_b);
+                r.literalBytes++;
+            };
+            i++;
+            while(at(i) != c)
+            {
+                int b = at(i);
+                if(b == -1) return failLiteral(c == '"' ? LITERAL_UNTERMINATED_STRING : LITERAL_UNTERMINATED_CHAR, i);
+                if(b == '\n')
+                {
+                    line++;
+                    lineStart = i + 1;
+                }
+                if(b != '\\')
+                {
+                    if(c == '\'') charSymbols.raw(b);
+                    push(b);
+                    i++;
+                    continue;
+                }
+                LexLiteralError error = lexDecodeEscape([&] {return at(++i);}, push);
+                if(error != LITERAL_OK) return failLiteral(error, i);
+                charSymbols.escape();
+                i++;
+            }
+            size_t length = r.literalBytes - literalStart;
+            if(c == '\'' && charSymbols.check() != LITERAL_OK) return failLiteral(charSymbols.check(), i);
+            i++;
+            _out.token(c == '"' ? Tokens::STRING : Tokens::CHAR, literalStart, length, startLine, startCol);
+            r.tokens++;
+            continue;
+        }
+        return fail(LexCtError::CT_UNEXPECTED_SYMBOL, i);
+    }
+    return r;
+}
+
+/**
+ * @brief tokens and decoded literals of embedded source
+ *
+ */
+template<size_t NTokens, size_t NLiterals>
+struct LexEmbedded
+{
+    std::array<LexCompactToken, NTokens> tokens;
+    std::array<char, NLiterals> literals;
+    const char* source;
+
+    /**
+     * @brief text of token (decoded bytes for STRING and CHAR)
+     *
+     */
+    constexpr std::string_view text(const LexCompactToken& _t) const
+    {
+        if(_t.type == Tokens::STRING || _t.type == Tokens::CHAR) return std::string_view(literals.data() + _t.offset, _t.length);
+        return std::string_view(source + _t.offset, _t.length);
+    }
+};
+
+/**
+ * @brief instantiated on lexing error, static_assert shows error kind and position
+ *
+ */
+template<LexCtError Error, LexLiteralError LiteralError, uint32_t Line, uint32_t Col>
+struct LexEmbeddedError
+{
+    static_assert(Error == LexCtError::CT_OK, "embedded Theia source does not lex, see LexEmbeddedError<error, literal error, line, col>");
+    static constexpr bool ok = Error == LexCtError::CT_OK;
+};
+
+/**
+ * @brief counting output of the first pass
+ *
+ */
+struct LexCtCounter
+{
+    constexpr void token(Tokens, uint32_t, uint32_t, uint32_t, uint32_t) {}
+    constexpr void literal(unsigned char) {}
+};
+
+/**
+ * @brief output of the second pass, fills LexEmbedded
+ *
+ */
+template<typename Embedded>
+struct LexCtFiller
+{
+    Embedded* dest;
+    size_t token_ = 0;
+    size_t literal_ = 0;
+    constexpr void token(Tokens _type, uint32_t _offset, uint32_t _length, uint32_t _line, uint32_t _col)
+    {
+        dest->tokens[token_++] = {_type, _offset, _length, _line, _col};
+    }
+    constexpr void literal(unsigned char _c) {dest->literals[literal_++] = (char)_c;}
+};
+
+/**
+ * @brief lexes string literal at compile time
+ *
+ * @tparam Source Theia source
+ */
+template<LexFixedString Source>
+consteval auto lexEmbedded()
+{
+    constexpr LexCtResult count = [] {
+        LexCtCounter counter;
+        return lexConstexprScan(Source.data, Source.size(), counter);
+    }();
+    static_assert(LexEmbeddedError<count.error, count.literalError, count.errorLine, count.errorCol>::ok);
+    if constexpr (count.error != LexCtError::CT_OK)
+    {
+        return LexEmbedded<0, 0>{{}, {}, Source.data};
+    }
+    else
+    {
+        LexEmbedded<count.tokens, count.literalBytes> out{{}, {}, Source.data};
+        LexCtFiller<LexEmbedded<count.tokens, count.literalBytes>> filler{&out};
+        lexConstexprScan(Source.data, Source.size(), filler);
+        return out;
+    }
+}
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @file lex_decompress.hpp
+ * @brief streaming gzip/zstd input for LexAutomata
+ * @version 1.0
+ *
+ */
+#ifndef LEX_DECOMPRESS_HPP
+#define LEX_DECOMPRESS_HPP
+
+#include "lex_source.hpp"
+#if defined(LEX_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(LEX_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+/**
+ * @brief input formats detected by magic bytes
+ *
+ */
+enum LexCompression {
+    COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_ZSTD
+};
+
+/**
+ * @brief decompresses file on a background thread straight into lexer input blocks.
+ * Format is detected from magic bytes (gzip: 1F 8B, zstd: 28 B5 2F FD),
+ * anything else is passed through as plain text.
+ *
+ */
+class LexDecompressSource : public LexAsyncSource
+{
+private:
+    FILE* f;
+    LexCompression format;
+    //compressed input
+    bytes in;
+    size_t inPos = 0;
+    size_t inEnd = 0;
+    bool inEof = false;
+    bool frameEnded = false;
+#if defined(LEX_HAVE_ZLIB)
+    z_stream zs = {};
+#endif
+#if defined(LEX_HAVE_ZSTD)
+    ZSTD_DCtx* zd = nullptr;
+#endif
+
+    /**
+     * @brief reads next chunk of compressed input
+     *
+     * @return false on end of file
+     */
+    bool readInput()
+    {
+        inPos = 0;
+        inEnd = fread(in.data(), 1, in.size(), f);
+        if(inEnd == 0) inEof = true;
+        return inEnd != 0;
+    }
+
+#if defined(LEX_HAVE_ZLIB)
+    size_t inflateBlock(unsigned char* _dest, size_t _size)
+    {
+        zs.next_out = _dest;
+        zs.avail_out = _size;
+        while(zs.avail_out != 0)
+        {
+            if(inPos == inEnd && !readInput())
+            {
+                if(!frameEnded) throw std::runtime_error("gzip stream is truncated");
+                break;
+            }
+            //next gzip member after the end of previous one
+            if(frameEnded)
+            {
+                if(inflateReset(&zs) != Z_OK) throw std::runtime_error("gzip: inflateReset failed");
+                frameEnded = false;
+            }
+            zs.next_in = in.data() + inPos;
+            zs.avail_in = inEnd - inPos;
+            int ret = inflate(&zs, Z_NO_FLUSH);
+            inPos = inEnd - zs.avail_in;
+            if(ret == Z_STREAM_END) frameEnded = true;
+            else if(ret != Z_OK && ret != Z_BUF_ERROR)
+                throw std::runtime_error(std::string("gzip stream is corrupted: ") + (zs.msg != nullptr ? zs.msg : "unknown error"));
+        }
+        return _size - zs.avail_out;
+    }
+#endif
+
+#if defined(LEX_HAVE_ZSTD)
+    size_t zstdBlock(unsigned char* _dest, size_t _size)
+    {
+        ZSTD_outBuffer out = {_dest, _size, 0};
+        while(out.pos != out.size)
+        {
+            if(inPos == inEnd && !readInput())
+            {
+                if(!frameEnded) throw std::runtime_error("zstd stream is truncated");
+                break;
+            }
+            ZSTD_inBuffer zin = {in.data(), inEnd, inPos};
+            size_t ret = ZSTD_decompressStream(zd, &out, &zin);
+            inPos = zin.pos;
+            if(ZSTD_isError(ret)) throw std::runtime_error(std::string("zstd stream is corrupted: ") + ZSTD_getErrorName(ret));
+            frameEnded = ret == 0;
+        }
+        return out.pos;
+    }
+#endif
+
+protected:
+    size_t produce(unsigned char* _dest, size_t _size) override
+    {
+        switch (format)
+        {
+#if defined(LEX_HAVE_ZLIB)
+        case COMPRESSION_GZIP:
+            return inflateBlock(_dest, _size);
+#endif
+#if defined(LEX_HAVE_ZSTD)
+        case COMPRESSION_ZSTD:
+            return zstdBlock(_dest, _size);
+#endif
+        default:
+        {
+            size_t n = 0;
+            while(n < _size && (inPos != inEnd || readInput()))
+            {
+                size_t chunk = inEnd - inPos < _size - n ? inEnd - inPos : _size - n;
+                memcpy(_dest + n, in.data() + inPos, chunk);
+                inPos += chunk;
+                n += chunk;
+            }
+            return n;
+        }
+        }
+    }
+
+public:
+    /**
+     * @brief Construct a new Lex Decompress Source object
+     *
+     * @param _path path to (compressed) file
+     * @param _blockSize size of decompressed block handed to lexer
+     * @param _blockCount number of decompressed blocks in flight
+     */
+    LexDecompressSource(std::string _path, size_t _blockSize = LEX_INPUT_BLOCK, size_t _blockCount = 4)
+        : LexAsyncSource(_blockSize, _blockCount), in(LEX_INPUT_BLOCK)
+    {
+        f = fopen(_path.c_str(), "rb");
+        if(f == nullptr) throw std::invalid_argument("argument '_path' is not invalid");
+        readInput();
+        const unsigned char* m = in.data();
+        if(inEnd >= 2 && m[0] == 0x1F && m[1] == 0x8B) format = COMPRESSION_GZIP;
+        else if(inEnd >= 4 && m[0] == 0x28 && m[1] == 0xB5 && m[2] == 0x2F && m[3] == 0xFD) format = COMPRESSION_ZSTD;
+        else format = COMPRESSION_NONE;
+
+        if(format == COMPRESSION_GZIP)
+        {
+#if defined(LEX_HAVE_ZLIB)
+            //15 + 32: max window, gzip or zlib header auto-detection
+            if(inflateInit2(&zs, 15 + 32) != Z_OK)
+            {
+                fclose(f);
+                throw std::runtime_error("gzip: inflateInit2 failed");
+            }
+#else
+            fclose(f);
+            throw std::runtime_error("gzip support is not compiled in (LEX_HAVE_ZLIB)");
+#endif
+        }
+        if(format == COMPRESSION_ZSTD)
+        {
+#if defined(LEX_HAVE_ZSTD)
+            zd = ZSTD_createDCtx();
+            if(zd == nullptr)
+            {
+                fclose(f);
+                throw std::runtime_error("zstd: ZSTD_createDCtx failed");
+            }
+#else
+            fclose(f);
+            throw std::runtime_error("zstd support is not compiled in (LEX_HAVE_ZSTD)");
+#endif
+        }
+        start();
+    }
+
+    ~LexDecompressSource()
+    {
+        stop();
+#if defined(LEX_HAVE_ZLIB)
+        if(format == COMPRESSION_GZIP) inflateEnd(&zs);
+#endif
+#if defined(LEX_HAVE_ZSTD)
+        if(zd != nullptr) ZSTD_freeDCtx(zd);
+#endif
+        fclose(f);
+    }
+
+    inline LexCompression getFormat() {return format;}
+};
+
+#endif
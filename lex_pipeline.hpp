@@ -0,0 +1,326 @@
+/**
+ * @file lex_pipeline.hpp
+ * @brief lexer->parser pipeline: LexAutomata on its own thread, tokens in lock-free SPSC ring
+ * @version 1.0
+ *
+ */
+#ifndef LEX_PIPELINE_HPP
+#define LEX_PIPELINE_HPP
+
+#include <atomic>
+#include <thread>
+#include <new>
+#include <cstdint>
+#include "lex_automata.hpp"
+
+/**
+ * @brief size of cache line, used to keep producer and consumer indices apart
+ *
+ */
+#define LEX_CACHE_LINE 64
+
+/**
+ * @brief how consumer (or producer on full ring) waits
+ * WAIT_SPIN - busy loop, WAIT_YIELD - std::this_thread::yield(), WAIT_BLOCK - sleep on atomic wait
+ */
+enum LexWaitPolicy {
+    WAIT_SPIN, WAIT_YIELD, WAIT_BLOCK
+};
+
+/**
+ * @brief state of producer side of the ring
+ *
+ */
+enum LexStreamState {
+    STREAM_RUNNING, STREAM_DONE, STREAM_FAILED
+};
+
+/**
+ * @brief bounded lock-free single-producer/single-consumer ring buffer.
+ * Producer writes slots privately and makes them visible with publish(),
+ * so tokens are handed over in batches with one release store.
+ *
+ * @tparam T element type
+ */
+template<typename T>
+class SpscRing
+{
+private:
+    //consumer side
+    alignas(LEX_CACHE_LINE) std::atomic<size_t> head;
+    size_t cachedTail;
+    //producer side
+    alignas(LEX_CACHE_LINE) std::atomic<size_t> tail;
+    size_t cachedHead;
+    size_t pendingTail;
+    //shared, read-only after construction
+    alignas(LEX_CACHE_LINE) T* slots;
+    size_t mask;
+public:
+    /**
+     * @brief Construct a new Spsc Ring object
+     *
+     * @param _capacity number of slots, rounded up to power of two
+     */
+    SpscRing(size_t _capacity)
+    {
+        size_t cap = 2;
+        while(cap < _capacity) cap <<= 1;
+        mask = cap - 1;
+        slots = static_cast<T*>(::operator new(cap * sizeof(T), std::align_val_t(alignof(T) > LEX_CACHE_LINE ? alignof(T) : LEX_CACHE_LINE)));
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        cachedTail = 0;
+        cachedHead = 0;
+        pendingTail = 0;
+    }
+
+    ~SpscRing()
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        for (; h != pendingTail; h++) slots[h & mask].~T();
+        ::operator delete(slots, std::align_val_t(alignof(T) > LEX_CACHE_LINE ? alignof(T) : LEX_CACHE_LINE));
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    inline size_t capacity() {return mask + 1;}
+
+    /**
+     * @brief (producer) construct element in next free slot, not visible until publish()
+     *
+     * @param _v value
+     * @return false if ring is full
+     */
+    inline bool tryPush(T&& _v)
+    {
+        if(pendingTail - cachedHead > mask)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+            if(pendingTail - cachedHead > mask) return false;
+        }
+        new (&slots[pendingTail & mask]) T(std::move(_v));
+        pendingTail++;
+        return true;
+    }
+
+    /**
+     * @brief (producer) number of written but not yet published elements
+     *
+     */
+    inline size_t pending() {return pendingTail - tail.load(std::memory_order_relaxed);}
+
+    /**
+     * @brief (producer) checks if ring is full for given consumer position
+     *
+     * @param _head consumer position
+     */
+    inline bool fullAt(size_t _head) {return pendingTail - _head > mask;}
+
+    /**
+     * @brief (producer) make all pushed elements visible to consumer
+     *
+     */
+    inline void publish() {tail.store(pendingTail, std::memory_order_release);}
+
+    /**
+     * @brief (producer) current consumer position, for waiting on free space
+     *
+     */
+    inline std::atomic<size_t>& headIndex() {return head;}
+
+    /**
+     * @brief (consumer) hands every published element to _f and frees the slots
+     *
+     * @param _f callable with signature void(T&)
+     * @return number of consumed elements
+     */
+    template<typename F>
+    size_t consume(F&& _f)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h == cachedTail)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if(h == cachedTail) return 0;
+        }
+        size_t n = cachedTail - h;
+        for (; h != cachedTail; h++)
+        {
+            _f(slots[h & mask]);
+            slots[h & mask].~T();
+        }
+        head.store(h, std::memory_order_release);
+        return n;
+    }
+};
+
+/**
+ * @brief runs LexAutomata::scanInto on a separate thread and streams tokens to consumer.
+ * Producer blocks (per wait policy) when ring is full; end of stream and
+ * lexing error are signalled through state, error carries the diagnostic.
+ *
+ */
+class LexPipeline
+{
+private:
+    /**
+     * @brief producer sink for LexAutomata::scanInto
+     *
+     */
+    class Sink
+    {
+    private:
+        LexPipeline* p;
+    public:
+        Sink(LexPipeline* _p) : p(_p) {}
+        inline void push_back(LexToken&& _t)
+        {
+            while(!p->ring.tryPush(std::move(_t)))
+            {
+                p->flush();
+                p->waitForSpace();
+            }
+            if(p->ring.pending() >= p->batchSize) p->flush();
+        }
+    };
+
+    LexAutomata* lex;
+    SpscRing<LexToken> ring;
+    size_t batchSize;
+    LexWaitPolicy wait;
+    //bumped on every publish and on end of stream, consumer sleeps on it in BLOCK mode
+    alignas(LEX_CACHE_LINE) std::atomic<uint32_t> epoch;
+    std::atomic<int> state;
+    std::string error;
+    std::thread worker;
+
+    inline void flush()
+    {
+        ring.publish();
+        epoch.fetch_add(1, std::memory_order_release);
+        if(wait == LexWaitPolicy::WAIT_BLOCK) epoch.notify_one();
+    }
+
+    inline void waitForSpace()
+    {
+        if(wait == LexWaitPolicy::WAIT_SPIN) return;
+        if(wait == LexWaitPolicy::WAIT_YIELD) {std::this_thread::yield(); return;}
+        size_t h = ring.headIndex().load(std::memory_order_acquire);
+        //consumer may have freed slots before we got here, then it will not notify again
+        if(!ring.fullAt(h)) return;
+        ring.headIndex().wait(h, std::memory_order_acquire);
+    }
+
+    void produce()
+    {
+        Sink sink(this);
+        bool ok = false;
+        try
+        {
+            ok = lex->scanInto(&sink);
+            if(!ok) error = lex->getLastError();
+        }
+        catch(const std::exception& e)
+        {
+            error = e.what();
+        }
+        ring.publish();
+        state.store(ok ? LexStreamState::STREAM_DONE : LexStreamState::STREAM_FAILED, std::memory_order_release);
+        epoch.fetch_add(1, std::memory_order_release);
+        epoch.notify_one();
+    }
+
+public:
+    /**
+     * @brief Construct a new Lex Pipeline object
+     *
+     * @param _lex lexer, must outlive pipeline
+     * @param _capacity ring size in tokens
+     * @param _batchSize tokens per publish
+     * @param _wait wait policy for both sides
+     */
+    LexPipeline(LexAutomata* _lex, size_t _capacity = 4096, size_t _batchSize = 64, LexWaitPolicy _wait = LexWaitPolicy::WAIT_BLOCK)
+        : ring(_capacity)
+    {
+        if(_lex == nullptr) throw std::invalid_argument("argument '_lex' is invalid");
+        lex = _lex;
+        batchSize = _batchSize == 0 ? 1 : (_batchSize > ring.capacity() ? ring.capacity() : _batchSize);
+        wait = _wait;
+        epoch.store(0, std::memory_order_relaxed);
+        state.store(LexStreamState::STREAM_RUNNING, std::memory_order_relaxed);
+    }
+
+    ~LexPipeline()
+    {
+        if(worker.joinable())
+        {
+            //drain so producer can never be stuck on a full ring
+            while(drain([](LexToken&) {}) != 0) {}
+            worker.join();
+        }
+    }
+
+    LexPipeline(const LexPipeline&) = delete;
+    LexPipeline& operator=(const LexPipeline&) = delete;
+
+    /**
+     * @brief starts lexer thread
+     *
+     */
+    void start()
+    {
+        if(worker.joinable()) throw std::logic_error("pipeline is already started");
+        worker = std::thread(&LexPipeline::produce, this);
+    }
+
+    /**
+     * @brief (consumer) waits for tokens and hands every available token to _f
+     *
+     * @param _f callable with signature void(LexToken&)
+     * @return number of consumed tokens, 0 means end of stream (check failed())
+     */
+    template<typename F>
+    size_t drain(F&& _f)
+    {
+        while(true)
+        {
+            uint32_t e = epoch.load(std::memory_order_acquire);
+            int s = state.load(std::memory_order_acquire);
+            size_t n = ring.consume(_f);
+            if(n != 0)
+            {
+                if(wait == LexWaitPolicy::WAIT_BLOCK) ring.headIndex().notify_one();
+                return n;
+            }
+            //state was read before consume, so nothing can be left behind
+            if(s != LexStreamState::STREAM_RUNNING) return 0;
+            if(wait == LexWaitPolicy::WAIT_YIELD) std::this_thread::yield();
+            else if(wait == LexWaitPolicy::WAIT_BLOCK) epoch.wait(e, std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * @brief waits for lexer thread to finish
+     *
+     */
+    void join()
+    {
+        if(worker.joinable()) worker.join();
+    }
+
+    /**
+     * @brief true when stream ended with lexing error
+     *
+     */
+    inline bool failed() {return state.load(std::memory_order_acquire) == LexStreamState::STREAM_FAILED;}
+
+    /**
+     * @brief diagnostic of failed stream, valid once drain() returned 0
+     *
+     */
+    inline const std::string& getError() {return error;}
+};
+
+#endif
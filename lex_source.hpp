@@ -0,0 +1,277 @@
+/**
+ * @file lex_source.hpp
+ * @brief input sources that fill blocks on a background thread while LexAutomata consumes them
+ * @version 1.0
+ *
+ */
+#ifndef LEX_SOURCE_HPP
+#define LEX_SOURCE_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <cerrno>
+#include <cstring>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <poll.h>
+#endif
+#include "lex_automata.hpp"
+
+/**
+ * @brief alignment of blocks filled by LexAsyncSource
+ *
+ */
+#define LEX_BLOCK_ALIGN 4096
+
+/**
+ * @brief default block size of LexPipeSource
+ *
+ */
+#define LEX_PIPE_BLOCK (1 << 20)
+
+/**
+ * @brief base for sources that produce input on a separate thread.
+ * Owns a fixed set of aligned blocks: lexer holds one of them, producer
+ * fills the rest ahead, so memory is bounded by blockCount * blockSize.
+ * Derived class implements produce() and must call start() at the end of its
+ * constructor and stop() at the beginning of its destructor.
+ *
+ */
+class LexAsyncSource : public LexSource
+{
+private:
+    struct Block
+    {
+        unsigned char* data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+    //counters of blocks: filled by producer, handed to lexer, given back by lexer
+    size_t filled = 0;
+    size_t handed = 0;
+    size_t released = 0;
+    bool finished = false;
+    bool stopping = false;
+    std::string error;
+    std::mutex m;
+    std::condition_variable cv;
+    std::thread worker;
+
+    void run()
+    {
+        for (size_t i = 0; ; i++)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] {return stopping || i - released < blocks.size();});
+                if(stopping) return;
+            }
+            Block& b = blocks[i % blocks.size()];
+            try
+            {
+                b.size = produce(b.data, blockSize);
+            }
+            catch(const std::exception& e)
+            {
+                std::lock_guard<std::mutex> lock(m);
+                error = e.what();
+                finished = true;
+                cv.notify_all();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if(b.size == 0) finished = true;
+                else filled = i + 1;
+            }
+            cv.notify_all();
+            if(b.size == 0) return;
+        }
+    }
+
+protected:
+    /**
+     * @brief (producer thread) fills _dest with next part of input
+     *
+     * @param _dest block
+     * @param _size block capacity
+     * @return number of bytes written, 0 on end of input. Exceptions are rethrown to lexer
+     */
+    virtual size_t produce(unsigned char* _dest, size_t _size) = 0;
+
+    /**
+     * @brief (any thread) wakes producer blocked inside produce(), called by stop()
+     *
+     */
+    virtual void interrupt() {}
+
+    void start()
+    {
+        worker = std::thread(&LexAsyncSource::run, this);
+    }
+
+    /**
+     * @brief stops producer thread. Producer blocked inside produce() is woken by interrupt()
+     *
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        interrupt();
+        if(worker.joinable()) worker.join();
+    }
+
+public:
+    /**
+     * @brief Construct a new Lex Async Source object
+     *
+     * @param _blockSize size of one block
+     * @param _blockCount number of blocks (2 - double buffering)
+     */
+    LexAsyncSource(size_t _blockSize, size_t _blockCount)
+    {
+        if(_blockSize == 0) throw std::invalid_argument("argument '_blockSize' is invalid");
+        if(_blockCount < 2) throw std::invalid_argument("argument '_blockCount' is invalid");
+        blockSize = (_blockSize + LEX_BLOCK_ALIGN - 1) / LEX_BLOCK_ALIGN * LEX_BLOCK_ALIGN;
+        for (size_t i = 0; i < _blockCount; i++)
+        {
+            blocks.push_back({static_cast<unsigned char*>(::operator new(blockSize, std::align_val_t(LEX_BLOCK_ALIGN))), 0});
+        }
+    }
+
+    ~LexAsyncSource()
+    {
+        stop();
+        for (size_t i = 0; i < blocks.size(); i++) ::operator delete(blocks[i].data, std::align_val_t(LEX_BLOCK_ALIGN));
+    }
+
+    LexAsyncSource(const LexAsyncSource&) = delete;
+    LexAsyncSource& operator=(const LexAsyncSource&) = delete;
+
+    size_t nextBlock(const unsigned char** _data) override
+    {
+        std::unique_lock<std::mutex> lock(m);
+        //lexer is done with everything handed before
+        if(released != handed)
+        {
+            released = handed;
+            cv.notify_all();
+        }
+        cv.wait(lock, [&] {return filled > handed || finished;});
+        if(filled > handed)
+        {
+            Block& b = blocks[handed % blocks.size()];
+            handed++;
+            *_data = b.data;
+            return b.size;
+        }
+        if(!error.empty()) throw std::runtime_error(error);
+        return 0;
+    }
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * @brief reader for non-seekable descriptors (stdin, pipes, FIFOs).
+ * Double buffered: background thread read(2)s block N+1 while lexer walks block N.
+ * Block is handed off as soon as data stops arriving, so slow writers (build systems)
+ * are lexed as they write. LexAutomata only ungets the byte it just read, so lookahead
+ * never needs the previous block and crossing block boundaries is safe.
+ *
+ */
+class LexPipeSource : public LexAsyncSource
+{
+private:
+    int fd;
+    bool ownsFd;
+    //stop() writes to wake[1] to break poll() of a reader waiting for data
+    int wake[2];
+
+    /**
+     * @brief waits until fd has data or end of input
+     *
+     * @param _timeout poll(2) timeout in ms, -1 waits forever
+     * @return false on timeout or interrupt()
+     */
+    bool waitInput(int _timeout)
+    {
+        pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+        while(true)
+        {
+            int r = poll(fds, 2, _timeout);
+            if(r < 0)
+            {
+                if(errno == EINTR) continue;
+                throw std::runtime_error(std::string("poll failed: ") + strerror(errno));
+            }
+            if(fds[1].revents != 0) return false;
+            return r != 0;
+        }
+    }
+
+protected:
+    size_t produce(unsigned char* _dest, size_t _size) override
+    {
+        //block for the first bytes, then take only what is already there
+        size_t n = 0;
+        while(n < _size && waitInput(n == 0 ? -1 : 0))
+        {
+            ssize_t r = read(fd, _dest + n, _size - n);
+            if(r == 0) break;
+            if(r < 0)
+            {
+                if(errno == EINTR || errno == EAGAIN) continue;
+                throw std::runtime_error(std::string("read failed: ") + strerror(errno));
+            }
+            n += r;
+        }
+        return n;
+    }
+
+    void interrupt() override
+    {
+        char c = 0;
+        while(write(wake[1], &c, 1) < 0 && errno == EINTR) {}
+    }
+
+public:
+    /**
+     * @brief Construct a new Lex Pipe Source object
+     *
+     * @param _fd opened descriptor
+     * @param _ownsFd close descriptor in destructor
+     * @param _blockSize size of one of two blocks
+     */
+    LexPipeSource(int _fd, bool _ownsFd = false, size_t _blockSize = LEX_PIPE_BLOCK)
+        : LexAsyncSource(_blockSize, 2)
+    {
+        if(_fd < 0) throw std::invalid_argument("argument '_fd' is not invalid");
+        if(pipe(wake) != 0) throw std::runtime_error(std::string("pipe failed: ") + strerror(errno));
+        fd = _fd;
+        ownsFd = _ownsFd;
+        start();
+    }
+
+    /**
+     * @brief destructor interrupts a pending read, writer side may stay open
+     *
+     */
+    ~LexPipeSource()
+    {
+        stop();
+        close(wake[0]);
+        close(wake[1]);
+        if(ownsFd) close(fd);
+    }
+};
+#endif
+
+#endif
@@ -0,0 +1,586 @@
+/**
+ * @file lex_test.cpp
+ * @brief checks of literal decoding and lexer diagnostics
+ * @version 1.0
+ *
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include "lex_automata.hpp"
+#include "lex_constexpr.hpp"
+#include "lex_decompress.hpp"
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) \
+        { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            failures++; \
+        } \
+    } while(0)
+
+/**
+ * @brief lexes _src, keeps lexer for diagnostics
+ *
+ */
+struct Lexed
+{
+    FILE* f;
+    LexAutomata* lex;
+    std::vector<LexToken> tokens;
+    bool ok;
+
+    Lexed(const std::string& _src)
+    {
+        f = std::tmpfile();
+        fwrite(_src.data(), 1, _src.size(), f);
+        lex = new LexAutomata(f);
+        ok = lex->scanInto(&tokens);
+    }
+    ~Lexed()
+    {
+        delete lex;
+        fclose(f);
+    }
+
+    inline std::string text(size_t _i)
+    {
+        bytes d = tokens[_i].getData();
+        return std::string(d.begin(), d.end());
+    }
+    inline bool failedWith(const std::string& _state)
+    {
+        return !ok && lex->getLastError().find("Error at state: " + _state + "!") != std::string::npos;
+    }
+};
+
+/**
+ * @brief source must lex to one literal token of _type with decoded _expected
+ *
+ */
+bool decodesTo(const std::string& _src, Tokens _type, const std::string& _expected)
+{
+    Lexed l(_src);
+    return l.ok && l.tokens.size() == 1 && l.tokens[0].getType() == _type && l.text(0) == _expected;
+}
+
+/**
+ * @brief literal error of constexpr lexer run at runtime
+ *
+ */
+LexLiteralError ctLiteralError(const std::string& _src)
+{
+    LexCtCounter counter;
+    LexCtResult r = lexConstexprScan(_src.data(), _src.size(), counter);
+    return r.error == LexCtError::CT_BAD_LITERAL ? r.literalError : LITERAL_OK;
+}
+
+void testEscapes()
+{
+    CHECK(decodesTo("\"a\\nb\"", Tokens::STRING, "a\nb"));
+    CHECK(decodesTo("\"a\\tb\"", Tokens::STRING, "a\tb"));
+    CHECK(decodesTo("\"a\\\\b\"", Tokens::STRING, "a\\b"));
+    CHECK(decodesTo("\"a\\\"b\"", Tokens::STRING, "a\"b"));
+    CHECK(decodesTo("\"a\\'b\"", Tokens::STRING, "a'b"));
+    CHECK(decodesTo("\"\\x41\\x7e\"", Tokens::STRING, "A~"));
+    CHECK(decodesTo("\"\\u{41}\\u{e9}\\u{20AC}\\u{1F600}\"", Tokens::STRING, "A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"));
+    CHECK(decodesTo("\"\"", Tokens::STRING, ""));
+    CHECK(decodesTo("\"no escapes at all\"", Tokens::STRING, "no escapes at all"));
+
+    CHECK(decodesTo("'a'", Tokens::CHAR, "a"));
+    CHECK(decodesTo("'\\n'", Tokens::CHAR, "\n"));
+    CHECK(decodesTo("'\\''", Tokens::CHAR, "'"));
+    CHECK(decodesTo("'\\x41'", Tokens::CHAR, "A"));
+    //one escape is one symbol whatever byte it produces
+    CHECK(decodesTo("'\\xC3'", Tokens::CHAR, "\xC3"));
+    CHECK(decodesTo("'\\xF0'", Tokens::CHAR, "\xF0"));
+    CHECK(decodesTo("'\\u{1F600}'", Tokens::CHAR, "\xF0\x9F\x98\x80"));
+    //raw UTF-8 sequence is one symbol
+    CHECK(decodesTo("'\xC3\xA9'", Tokens::CHAR, "\xC3\xA9"));
+
+    //literal spanning lines is reported at its opening quote
+    Lexed l("a =\n  \"x\ny\"; b");
+    CHECK(l.ok && l.tokens.size() == 5);
+    if(l.tokens.size() == 5)
+    {
+        CHECK(l.tokens[2].getLn() == 2 && l.tokens[2].getCol() == 3);
+        CHECK(l.tokens[4].getLn() == 3 && l.tokens[4].getCol() == 5);
+    }
+}
+
+void testDiagnostics()
+{
+    struct Case {const char* src; LexLiteralError error;};
+    const Case cases[] = {
+        {"\"bad \\q\"", LITERAL_UNKNOWN_ESCAPE},
+        {"\"\\xG1\"", LITERAL_BAD_HEX_ESCAPE},
+        {"\"\\x4\"", LITERAL_BAD_HEX_ESCAPE},
+        {"\"\\u41\"", LITERAL_NO_UNICODE_BRACE},
+        {"\"\\u{4G}\"", LITERAL_BAD_UNICODE_DIGIT},
+        {"\"\\u{1234567}\"", LITERAL_UNICODE_TOO_LONG},
+        {"\"\\u{}\"", LITERAL_EMPTY_UNICODE},
+        {"\"\\u{110000}\"", LITERAL_UNICODE_OUT_OF_RANGE},
+        {"\"\\u{D800}\"", LITERAL_UNICODE_SURROGATE},
+        {"\"abc\\", LITERAL_UNTERMINATED_ESCAPE},
+        {"\"abc", LITERAL_UNTERMINATED_STRING},
+        {"'a", LITERAL_UNTERMINATED_CHAR},
+        {"''", LITERAL_EMPTY_CHAR},
+        {"'ab'", LITERAL_CHAR_NOT_ONE_SYMBOL},
+        {"'\\x41\\x42'", LITERAL_CHAR_NOT_ONE_SYMBOL},
+        {"'\xC3\xA9\xC3\xA9'", LITERAL_CHAR_NOT_ONE_SYMBOL},
+        //raw bytes of char must be complete UTF-8 sequences
+        {"'\x80'", LITERAL_INVALID_UTF8_CHAR},
+        {"'\xC3\xA9\xA9'", LITERAL_INVALID_UTF8_CHAR},
+        {"'\xC3'", LITERAL_INVALID_UTF8_CHAR},
+        {"'\xC3" "a'", LITERAL_INVALID_UTF8_CHAR},
+        {"'\xE2\x82'", LITERAL_INVALID_UTF8_CHAR},
+        {"'\xFF'", LITERAL_INVALID_UTF8_CHAR},
+        {"'\xC3\\n'", LITERAL_INVALID_UTF8_CHAR},
+        {"'\xE2\x82\xAC'", LITERAL_OK},
+    };
+    //both lexers report the same error for every case
+    for (const Case& c : cases)
+    {
+        Lexed l(c.src);
+        if(c.error == LITERAL_OK) CHECK(l.ok);
+        else if(c.error == LITERAL_UNKNOWN_ESCAPE) CHECK(l.failedWith(std::string(stringLiteralErrors[c.error]) + " '\\q'"));
+        else CHECK(l.failedWith(stringLiteralErrors[c.error]));
+        CHECK(ctLiteralError(c.src) == c.error);
+    }
+
+    //caret points at the offending byte
+    Lexed l("s = \"bad \\q\";");
+    CHECK(l.lex->getLastError().find("(Ln 1, Col 11)") != std::string::npos);
+}
+
+void testBlockBoundary()
+{
+    //literal body crosses the LEX_INPUT_BLOCK boundary, with an escape split right on it
+    for (size_t shift = 0; shift < 4; shift++)
+    {
+        std::string body(LEX_INPUT_BLOCK - 8 + shift, 'a');
+        std::string src = "x = \"" + body + "\\u{e9}\\x41" + std::string(100, 'b') + "\";";
+        Lexed l(src);
+        CHECK(l.ok);
+        CHECK(l.tokens.size() == 4);
+        if(l.tokens.size() == 4)
+        {
+            CHECK(l.tokens[2].getType() == Tokens::STRING);
+            CHECK(l.text(2) == body + "\xC3\xA9" "A" + std::string(100, 'b'));
+        }
+    }
+    //long literal that needs more than one arena chunk
+    std::string big(3 * LEX_ARENA_CHUNK, 'z');
+    CHECK(decodesTo("\"" + big + "\"", Tokens::STRING, big));
+}
+
+/**
+ * @brief source that fails after giving one block
+ *
+ */
+struct FailingSource : public LexSource
+{
+    std::string text = "a = 1;\nb = 2";
+    int calls = 0;
+    size_t nextBlock(const unsigned char** _data) override
+    {
+        if(calls++ == 0)
+        {
+            *_data = (const unsigned char*)text.data();
+            return text.size();
+        }
+        throw std::runtime_error("read failed: test");
+    }
+};
+
+void testSourceErrors()
+{
+    //source errors end the scan with false and a diagnostic, they are not thrown
+    {
+        FailingSource source;
+        LexAutomata lex(&source);
+        std::vector<LexToken> tokens;
+        CHECK(!lex.scanInto(&tokens));
+        CHECK(lex.getLastError().find("Error at state: Reading input!") != std::string::npos);
+        CHECK(lex.getLastError().find("read failed: test") != std::string::npos);
+    }
+    {
+        FailingSource source;
+        LexAutomata lex(&source);
+        LexStats s;
+        CHECK(!lex.scanStats(&s));
+        CHECK(lex.getLastError().find("read failed: test") != std::string::npos);
+    }
+}
+
+/**
+ * @brief token streams are equal by type, bytes and position
+ *
+ */
+bool sameTokens(std::vector<LexToken>& _a, std::vector<LexToken>& _b)
+{
+    if(_a.size() != _b.size()) return false;
+    for (size_t i = 0; i < _a.size(); i++)
+    {
+        if(_a[i].getType() != _b[i].getType() || _a[i].getData() != _b[i].getData()) return false;
+        if(_a[i].getLn() != _b[i].getLn() || _a[i].getCol() != _b[i].getCol()) return false;
+    }
+    return true;
+}
+
+void writeFile(const std::string& _path, const bytes& _content)
+{
+    FILE* f = fopen(_path.c_str(), "wb");
+    fwrite(_content.data(), 1, _content.size(), f);
+    fclose(f);
+}
+
+/**
+ * @brief lexes (compressed) file through LexDecompressSource with small blocks
+ *
+ */
+bool lexDecompressed(const std::string& _path, LexCompression _format, std::vector<LexToken>* _out, std::string* _error)
+{
+    LexDecompressSource source(_path, 4096, 3);
+    CHECK(source.getFormat() == _format);
+    LexAutomata lex(&source);
+    bool ok = lex.scanInto(_out);
+    *_error = lex.getLastError();
+    return ok;
+}
+
+void testDecompress()
+{
+    std::string text;
+    for (int i = 0; i < 3000; i++) text += "int v" + std::to_string(i) + " = " + std::to_string(i) + " * 1.5e-3; s = \"x\\u{e9}\";\n";
+    bytes plain(text.begin(), text.end());
+    std::vector<LexToken> expected;
+    {
+        Lexed l(text);
+        CHECK(l.ok);
+        expected = std::move(l.tokens);
+    }
+    std::string path = "lex_test_input";
+    std::vector<LexToken> out;
+    std::string error;
+
+    //plain text is passed through
+    writeFile(path, plain);
+    CHECK(lexDecompressed(path, LexCompression::COMPRESSION_NONE, &out, &error));
+    CHECK(sameTokens(out, expected));
+
+#if defined(LEX_HAVE_ZLIB)
+    auto gzip = [](const bytes& _data) {
+        z_stream zs = {};
+        deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        bytes out(deflateBound(&zs, _data.size()) + 32);
+        zs.next_in = (Bytef*)_data.data();
+        zs.avail_in = _data.size();
+        zs.next_out = out.data();
+        zs.avail_out = out.size();
+        deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        return out;
+    };
+    bytes gz = gzip(plain);
+
+    out.clear();
+    writeFile(path, gz);
+    CHECK(lexDecompressed(path, LexCompression::COMPRESSION_GZIP, &out, &error));
+    CHECK(sameTokens(out, expected));
+
+    //two members split in the middle of a line, as written by appending gzip
+    size_t half = plain.size() / 2 + 7;
+    bytes multi = gzip(bytes(plain.begin(), plain.begin() + half));
+    bytes second = gzip(bytes(plain.begin() + half, plain.end()));
+    multi.insert(multi.end(), second.begin(), second.end());
+    out.clear();
+    writeFile(path, multi);
+    CHECK(lexDecompressed(path, LexCompression::COMPRESSION_GZIP, &out, &error));
+    CHECK(sameTokens(out, expected));
+
+    bytes truncated(gz.begin(), gz.end() - 12);
+    out.clear();
+    writeFile(path, truncated);
+    CHECK(!lexDecompressed(path, LexCompression::COMPRESSION_GZIP, &out, &error));
+    CHECK(error.find("gzip stream is truncated") != std::string::npos);
+#endif
+
+#if defined(LEX_HAVE_ZSTD)
+    auto zstd = [](const bytes& _data) {
+        bytes out(ZSTD_compressBound(_data.size()));
+        out.resize(ZSTD_compress(out.data(), out.size(), _data.data(), _data.size(), 3));
+        return out;
+    };
+    bytes zst = zstd(plain);
+
+    out.clear();
+    writeFile(path, zst);
+    CHECK(lexDecompressed(path, LexCompression::COMPRESSION_ZSTD, &out, &error));
+    CHECK(sameTokens(out, expected));
+
+    size_t zhalf = plain.size() / 3 + 5;
+    bytes frames = zstd(bytes(plain.begin(), plain.begin() + zhalf));
+    bytes frame2 = zstd(bytes(plain.begin() + zhalf, plain.end()));
+    frames.insert(frames.end(), frame2.begin(), frame2.end());
+    out.clear();
+    writeFile(path, frames);
+    CHECK(lexDecompressed(path, LexCompression::COMPRESSION_ZSTD, &out, &error));
+    CHECK(sameTokens(out, expected));
+
+    bytes ztruncated(zst.begin(), zst.end() - 12);
+    out.clear();
+    writeFile(path, ztruncated);
+    CHECK(!lexDecompressed(path, LexCompression::COMPRESSION_ZSTD, &out, &error));
+    CHECK(error.find("zstd stream is truncated") != std::string::npos);
+#endif
+    std::remove(path.c_str());
+}
+
+/**
+ * @brief source that hands input in blocks of fixed size
+ *
+ */
+struct ChunkedSource : public LexSource
+{
+    std::string text;
+    size_t chunk;
+    size_t pos = 0;
+    ChunkedSource(const std::string& _text, size_t _chunk) : text(_text), chunk(_chunk) {}
+    size_t nextBlock(const unsigned char** _data) override
+    {
+        size_t n = text.size() - pos < chunk ? text.size() - pos : chunk;
+        *_data = (const unsigned char*)text.data() + pos;
+        pos += n;
+        return n;
+    }
+};
+
+//lookahead and ungetByte around "/*", "**", ".5" and exponents
+#define BOUNDARY_LINE "x = .5 + 1.5e-3 - 2.25E-12; /* *b ** */ y = a.b ^ c; s = \"q\\u{e9}\";\n"
+
+void testBlockEdges()
+{
+    std::string text;
+    for (int i = 0; i < 3; i++) text += BOUNDARY_LINE;
+    Lexed expected(text);
+    CHECK(expected.ok);
+    //every construct straddles some block boundary
+    for (size_t chunk = 1; chunk <= 9; chunk++)
+    {
+        ChunkedSource source(text, chunk);
+        LexAutomata lex(&source);
+        std::vector<LexToken> out;
+        CHECK(lex.scanInto(&out));
+        CHECK(sameTokens(out, expected.tokens));
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+void testPipeSource()
+{
+    std::string text;
+    for (int i = 0; i < 2000; i++) text += BOUNDARY_LINE;
+    Lexed expected(text);
+    CHECK(expected.ok);
+    {
+        int fds[2];
+        CHECK(pipe(fds) == 0);
+        std::thread writer([&] {
+            for (size_t off = 0; off < text.size(); off += 777)
+            {
+                size_t n = text.size() - off < 777 ? text.size() - off : 777;
+                if(write(fds[1], text.data() + off, n) != (ssize_t)n) break;
+            }
+            close(fds[1]);
+        });
+        std::vector<LexToken> out;
+        {
+            LexPipeSource source(fds[0], true, 4096);
+            LexAutomata lex(&source);
+            CHECK(lex.scanInto(&out));
+        }
+        writer.join();
+        CHECK(sameTokens(out, expected.tokens));
+    }
+    {
+        //lexing error while writer keeps pipe open: data already written is lexed, destructor does not wait for writer
+        int fds[2];
+        CHECK(pipe(fds) == 0);
+        std::string bad = "int a = 1;\nx = $;\n";
+        CHECK(write(fds[1], bad.data(), bad.size()) == (ssize_t)bad.size());
+        {
+            LexPipeSource source(fds[0], true);
+            LexAutomata lex(&source);
+            std::vector<LexToken> out;
+            CHECK(!lex.scanInto(&out));
+            CHECK(lex.getLastError().find("(Ln 2, Col 5)") != std::string::npos);
+        }
+        close(fds[1]);
+    }
+}
+#endif
+
+void testTokensOutliveLexer()
+{
+    //literals share arena chunks with tokens, so tokens stay valid after lexer is gone
+    std::string src;
+    for (int i = 0; i < 20000; i++) src += "s = \"literal number " + std::to_string(i) + "\"; c = 'x';\n";
+    std::vector<LexToken> tokens;
+    {
+        FILE* f = std::tmpfile();
+        fwrite(src.data(), 1, src.size(), f);
+        {
+            LexAutomata lex(f);
+            CHECK(lex.scanInto(&tokens));
+        }
+        fclose(f);
+    }
+    CHECK(tokens.size() == 20000 * 8);
+    if(tokens.size() != 20000 * 8) return;
+    for (int i = 0; i < 20000; i += 997)
+    {
+        bytes s = tokens[i * 8 + 2].getData();
+        CHECK(std::string(s.begin(), s.end()) == "literal number " + std::to_string(i));
+        CHECK(tokens[i * 8 + 6].getData() == bytes{'x'});
+    }
+}
+
+/**
+ * @brief lines counted by count-only mode
+ *
+ */
+unsigned long long statLines(const std::string& _src)
+{
+    FILE* f = std::tmpfile();
+    fwrite(_src.data(), 1, _src.size(), f);
+    LexStats s;
+    {
+        LexAutomata lex(f);
+        lex.scanStats(&s);
+    }
+    fclose(f);
+    return s.lines;
+}
+
+/**
+ * @brief count-only mode must report same diagnostic as token scan
+ *
+ */
+bool sameError(const std::string& _src)
+{
+    FILE* f = std::tmpfile();
+    fwrite(_src.data(), 1, _src.size(), f);
+    LexStats s;
+    std::string statsError;
+    {
+        LexAutomata lex(f);
+        if(!lex.scanStats(&s)) statsError = lex.getLastError();
+    }
+    fclose(f);
+    Lexed l(_src);
+    return !l.ok && statsError == l.lex->getLastError();
+}
+
+void testStats()
+{
+    CHECK(statLines("") == 0);
+    CHECK(statLines("a") == 1);
+    CHECK(statLines("a\n") == 1);
+    CHECK(statLines("a\nb") == 2);
+    CHECK(statLines("a\n\n") == 2);
+    CHECK(statLines("\n") == 1);
+    CHECK(statLines("s = \"a\nb\";\n/* x\ny */\nc") == 5);
+    //last byte of input in its own block
+    CHECK(statLines(std::string(LEX_INPUT_BLOCK, ' ') + "\n") == 1);
+    CHECK(statLines(std::string(LEX_INPUT_BLOCK - 1, ' ') + "\na") == 2);
+    //counters are added per call, a repeated scan of consumed input adds nothing
+    {
+        FILE* f = std::tmpfile();
+        fputs("a;\nb;\nc;\n", f);
+        LexStats s;
+        {
+            LexAutomata lex(f);
+            CHECK(lex.scanStats(&s));
+            CHECK(lex.scanStats(&s));
+        }
+        fclose(f);
+        CHECK(s.lines == 3);
+        CHECK(s.bytes == 9);
+        CHECK(s.tokens == 6);
+    }
+
+    CHECK(sameError("a = 1;\nb = \"bad \\q\";\n"));
+    CHECK(sameError("a = 1; $"));
+    CHECK(sameError("'ab';"));
+    //erroneous line starts one or two blocks before the error
+    CHECK(sameError("a;\n" + std::string(LEX_INPUT_BLOCK, ' ') + "x = \"\\q\";"));
+    CHECK(sameError("a;\n" + std::string(2 * LEX_INPUT_BLOCK + 7, ' ') + "x = \"\\q\";"));
+    CHECK(sameError(std::string(LEX_INPUT_BLOCK - 3, ' ') + "x = \"\\q\";"));
+}
+
+#define EMBEDDED_SOURCE \
+    "class A extends B {\n" \
+    "    string s = \"a\\tb\\u{e9}\"; char c = '\\xC3'; char d = '\xC3\xA9';\n" \
+    "    int n = 42 + x.y; /* note */\n" \
+    "}\n"
+
+constexpr auto embedded = lexEmbedded<EMBEDDED_SOURCE>();
+
+//checked by the compiler: constexpr lexer must agree with LexAutomata
+static_assert(embedded.tokens.size() == 30);
+static_assert(embedded.tokens[0].type == Tokens::KW_CLASS);
+static_assert(embedded.text(embedded.tokens[1]) == "A");
+static_assert(embedded.tokens[2].type == Tokens::KW_EXTENDS);
+static_assert(embedded.tokens[8].type == Tokens::STRING);
+static_assert(embedded.text(embedded.tokens[8]) == "a\tb\xC3\xA9");
+static_assert(embedded.tokens[8].line == 2 && embedded.tokens[8].col == 16);
+static_assert(embedded.tokens[13].type == Tokens::CHAR);
+static_assert(embedded.text(embedded.tokens[13]) == "\xC3");
+static_assert(embedded.tokens[18].type == Tokens::CHAR);
+static_assert(embedded.text(embedded.tokens[18]) == "\xC3\xA9");
+static_assert(embedded.tokens[23].type == Tokens::NUMBER);
+static_assert(embedded.text(embedded.tokens[23]) == "42");
+static_assert(embedded.tokens[29].type == Tokens::BRACE_R);
+static_assert(embedded.tokens[29].line == 4 && embedded.tokens[29].col == 1);
+
+void testEmbedded()
+{
+    Lexed l(EMBEDDED_SOURCE);
+    CHECK(l.ok);
+    CHECK(l.tokens.size() == embedded.tokens.size());
+    for (size_t i = 0; i < l.tokens.size() && i < embedded.tokens.size(); i++)
+    {
+        CHECK(l.tokens[i].getType() == embedded.tokens[i].type);
+        CHECK(l.text(i) == embedded.text(embedded.tokens[i]));
+        CHECK(l.tokens[i].getLn() == embedded.tokens[i].line);
+        CHECK(l.tokens[i].getCol() == embedded.tokens[i].col);
+    }
+}
+
+int main()
+{
+    testEscapes();
+    testDiagnostics();
+    testBlockBoundary();
+    testTokensOutliveLexer();
+    testSourceErrors();
+    testDecompress();
+    testBlockEdges();
+#if defined(__unix__) || defined(__APPLE__)
+    testPipeSource();
+#endif
+    testEmbedded();
+    testStats();
+    if(failures != 0)
+    {
+        std::cout << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}
@@ -1,10 +1,96 @@
 #include <iostream>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
 #include "lex_automata.hpp"
+#include "lex_source.hpp"
 
-int main(int, char**) {
-    std::cout << "Hello, world!\n";
+/**
+ * @brief prints counters of count-only mode
+ *
+ */
+void printStats(LexStats& _s, double _ms)
+{
+    std::cout << "Lines: " << _s.lines << "\n";
+    std::cout << "Bytes: " << _s.bytes << "\n";
+    std::cout << "Tokens: " << _s.tokens << "\n";
+    std::cout << "Time: " << _ms << " ms (" << (_ms > 0 ? _s.bytes / 1048576.0 / (_ms / 1000.0) : 0) << " MB/s)\n";
+    std::cout << "\nTokens by type:\n";
+    for (int i = 0; i <= Tokens::MES_COLON; i++)
+    {
+        if(_s.byType[i] != 0) std::cout << "  " << stringTokens[i] << ": " << _s.byType[i] << "\n";
+    }
+    std::cout << "\nIdentifier lengths:\n";
+    for (int i = 0; i < LEX_STATS_ID_BINS; i++)
+    {
+        if(_s.idLengths[i] == 0) continue;
+        std::cout << "  " << i << (i == LEX_STATS_ID_BINS - 1 ? "+" : "") << ": " << _s.idLengths[i] << "\n";
+    }
+    std::cout << "\nLiteral sizes (bytes, decoded):\n";
+    for (int i = 0; i < LEX_STATS_SIZE_BINS; i++)
+    {
+        if(_s.literalSizes[i] == 0) continue;
+        if(i == 0) std::cout << "  0: ";
+        else std::cout << "  " << (1ull << (i - 1)) << "-" << (1ull << (i - 1)) * 2 - 1 << ": ";
+        std::cout << _s.literalSizes[i] << "\n";
+    }
+    std::cout << "  total: " << _s.literalBytes << "\n";
+    std::cout << "\nComments: " << _s.comments << " (" << _s.commentBytes << " bytes)\n";
+}
+
+int main(int argc, char** argv) {
+    bool stats = false;
+    std::string path = "pupa.txt";
+    for (int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--stats") == 0) stats = true;
+        else path = argv[i];
+    }
+
+    //"-" is stdin, usually a pipe from build system
+#if defined(__unix__) || defined(__APPLE__)
+    std::unique_ptr<LexPipeSource> stdinSource;
+#endif
+    std::unique_ptr<LexAutomata> lex;
+    if(path == "-")
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        stdinSource.reset(new LexPipeSource(STDIN_FILENO));
+        lex.reset(new LexAutomata(stdinSource.get()));
+#else
+        lex.reset(new LexAutomata(stdin));
+#endif
+    }
+    else lex.reset(new LexAutomata(path));
+
+    //read errors of sources end the scan with getLastError(), this catches failures around it
+    try
+    {
+        if(stats)
+        {
+            LexStats s;
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            bool ok = lex->scanStats(&s);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            if(!ok)
+            {
+                std::cout << lex->getLastError();
+                return 1;
+            }
+            printStats(s, ms);
+            return 0;
+        }
+
+        std::cout << "Hello, world!\n";
 
-    LexAutomata lex("pupa.txt");
-    std::vector<LexToken> out = {};
-    lex.scanTokens(&out);
+        std::vector<LexToken> out = {};
+        lex->scanTokens(&out);
+        if(!lex->getLastError().empty()) return 1;
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
 }